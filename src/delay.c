@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Short delays for bit-banged bus timing.
+ *
+ * nanosleep() is useless for the sub-microsecond setup and hold times of
+ * parallel peripherals, any call sleeps for at least the scheduler's timer
+ * slack.  Instead, a delay loop is calibrated against CLOCK_MONOTONIC at
+ * startup and used for the shortest delays, the clock itself is polled for
+ * delays of a few microseconds, and only long delays actually sleep.
+ *
+ * Calibration keeps the fastest of several runs and is then scaled up to
+ * the highest clock cpufreq may switch to, since a loop calibrated at a low
+ * clock would run short once the governor raises it.  Scaling down later
+ * only makes the loop delays longer.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "delay.h"
+#include "stats.h"
+
+#define CALIBRATE_LOOPS		100000
+#define CALIBRATE_RUNS		5
+
+/* Loop iterations per microsecond, scaled by 1024 */
+static uint64_t loops_per_us_1024;
+
+static inline uint64_t ts_to_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts_to_ns(&ts);
+}
+
+static void __attribute__((noinline)) delay_loop(uint64_t loops)
+{
+	while (loops--)
+		__asm__ __volatile__("" ::: "memory");
+}
+
+/* A cpufreq value in kHz for the CPU, or 0 when there is no cpufreq */
+static unsigned long cpufreq_khz(int cpu, const char *name)
+{
+	char path[96];
+	unsigned long khz = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path),
+	  "/sys/devices/system/cpu/cpu%d/cpufreq/%s", cpu, name);
+	f = fopen(path, "r");
+	if (f == NULL)
+		return 0;
+	if (fscanf(f, "%lu", &khz) != 1)
+		khz = 0;
+	fclose(f);
+
+	return khz;
+}
+
+void delay_init(void)
+{
+	uint64_t start, elapsed, best = UINT64_MAX;
+	unsigned long cur_khz, max_khz;
+	int i, cpu;
+
+	if (loops_per_us_1024)
+		return;
+
+	for (i = 0; i < CALIBRATE_RUNS; i++) {
+		start = now_ns();
+		delay_loop(CALIBRATE_LOOPS);
+		elapsed = now_ns() - start;
+		if (elapsed < best)
+			best = elapsed;
+	}
+
+	if (best == 0)
+		best = 1;
+	loops_per_us_1024 = (CALIBRATE_LOOPS * 1000ULL * 1024) / best;
+
+	/* The loop is CPU bound, its speed follows the core clock */
+	cpu = sched_getcpu();
+	if (cpu >= 0) {
+		cur_khz = cpufreq_khz(cpu, "scaling_cur_freq");
+		max_khz = cpufreq_khz(cpu, "cpuinfo_max_freq");
+		if (cur_khz && max_khz > cur_khz)
+			loops_per_us_1024 = loops_per_us_1024 * max_khz /
+			  cur_khz;
+	}
+	if (loops_per_us_1024 == 0)
+		loops_per_us_1024 = 1;
+}
+
+void ndelay(unsigned long nsec)
+{
+	struct timespec ts;
+	uint64_t deadline;
+	int ret;
+
+	assert(loops_per_us_1024);
+
+	if (nsec < DELAY_LOOP_NS) {
+		delay_loop(((nsec * loops_per_us_1024) / 1000 + 1023) / 1024);
+		if (stats_enabled)
+			stats_delay(0, nsec);
+		return;
+	}
+
+	deadline = now_ns() + nsec;
+
+	if (nsec < DELAY_SLEEP_NS) {
+		while (now_ns() < deadline);
+		if (stats_enabled)
+			stats_delay(0, nsec);
+		return;
+	}
+
+	/* Absolute deadline so an interrupted sleep resumes correctly */
+	ts.tv_sec = deadline / 1000000000ULL;
+	ts.tv_nsec = deadline % 1000000000ULL;
+	do {
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	} while (ret == EINTR);
+
+	/* Count the actual time, oversleeping shows up here */
+	if (stats_enabled)
+		stats_delay(1, now_ns() - (deadline - nsec));
+}
+
+void udelay(unsigned long usec)
+{
+	ndelay(usec * 1000);
+}
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __DELAY_H__
+#define __DELAY_H__
+
+/* Delays at or above this are slept, shorter ones are busy-waited since a
+ * sleep syscall alone typically overshoots by tens of microseconds. */
+#define DELAY_SLEEP_NS		100000
+
+/* Delays below this spin a calibrated loop rather than polling the clock,
+ * as reading CLOCK_MONOTONIC takes a significant part of a microsecond on
+ * the slower CPUs. */
+#define DELAY_LOOP_NS		2000
+
+/* Calibrate the busy-wait loop, must be called before ndelay()/udelay().
+ * Calling it more than once has no effect. */
+void delay_init(void);
+
+void ndelay(unsigned long nsec);
+void udelay(unsigned long usec);
+
+#endif //__DELAY_H__
@@ -0,0 +1,311 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Bulk DIO access by name.
+ *
+ * Setting or reading lines one gpioset/gpioget call at a time costs a
+ * process and a line request per pin.  Here a whole list is resolved up
+ * front, sorted by chip, and each chip gets one bulk request.  For outputs
+ * the values are passed with the request itself, so the lines of a chip
+ * change together in a single ioctl.  Lines are read as inputs, the same
+ * as gpioget.
+ */
+
+#include <errno.h>
+#include <gpiod.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "dio.h"
+#include "stats.h"
+
+#define CONSUMER "tshwctl"
+
+struct dio_board_line {
+	int model;
+	const char *name;
+	unsigned int chip;
+	unsigned int offset;
+};
+
+/* Lines the other tools in this package drive directly.  The DIO header
+ * pins have no such user here, so their chip and offset are taken from
+ * the names the device tree gives them, as are any other named lines. */
+static const struct dio_board_line dio_board[] = {
+	/* TS-7250-V3 LCD header, see hd44780.c */
+	{ 0x7250, "LCD_D0", 2, 10 },
+	{ 0x7250, "LCD_D1", 2, 9 },
+	{ 0x7250, "LCD_D2", 2, 12 },
+	{ 0x7250, "LCD_D3", 2, 11 },
+	{ 0x7250, "LCD_D4", 2, 16 },
+	{ 0x7250, "LCD_D5", 2, 15 },
+	{ 0x7250, "LCD_D6", 2, 18 },
+	{ 0x7250, "LCD_D7", 2, 17 },
+	{ 0x7250, "LCD_WR", 2, 19 },
+	{ 0x7250, "LCD_EN", 2, 20 },
+	{ 0x7250, "LCD_RS", 2, 21 },
+	/* TS-7250-V3 keypad header, see keypad_scan.c */
+	{ 0x7250, "KEYPAD_ROW0", 5, 1 },
+	{ 0x7250, "KEYPAD_ROW1", 5, 2 },
+	{ 0x7250, "KEYPAD_ROW2", 5, 3 },
+	{ 0x7250, "KEYPAD_ROW3", 5, 4 },
+	{ 0x7250, "KEYPAD_COL0", 5, 6 },
+	{ 0x7250, "KEYPAD_COL1", 5, 7 },
+	{ 0x7250, "KEYPAD_COL2", 5, 8 },
+	{ 0x7250, "KEYPAD_COL3", 5, 9 },
+};
+
+struct dio_ent {
+	char *name;
+	unsigned int chip;
+	unsigned int offset;
+	int value;
+	int order;		/* Position in the list as given */
+};
+
+static int dio_resolve(int model, struct dio_ent *e)
+{
+	struct gpiod_line *line;
+	const char *chipname;
+	char *end;
+	int i;
+
+	for (i = 0; i < sizeof(dio_board)/sizeof(dio_board[0]); i++) {
+		if (dio_board[i].model == model &&
+		  !strcasecmp(dio_board[i].name, e->name)) {
+			e->chip = dio_board[i].chip;
+			e->offset = dio_board[i].offset;
+			return 0;
+		}
+	}
+
+	if (!strncmp(e->name, "chip", 4) || !strncmp(e->name, "gpiochip", 8)) {
+		e->chip = strtoul(e->name + (e->name[0] == 'g' ? 8 : 4), &end,
+		  10);
+		if (*end == ':' && end[1]) {
+			e->offset = strtoul(end + 1, &end, 0);
+			if (*end == '\0')
+				return 0;
+		}
+	}
+
+	/* Kernel line names need a scan of every chip, so come last */
+	line = gpiod_line_find(e->name);
+	if (line) {
+		chipname = gpiod_chip_name(gpiod_line_get_chip(line));
+		e->chip = strtoul(chipname + strlen("gpiochip"), NULL, 10);
+		e->offset = gpiod_line_offset(line);
+		gpiod_line_close_chip(line);
+		return 0;
+	}
+
+	fprintf(stderr, "Unknown DIO line \"%s\"\n", e->name);
+	return -1;
+}
+
+static int dio_cmp(const void *a, const void *b)
+{
+	const struct dio_ent *x = a, *y = b;
+
+	if (x->chip != y->chip)
+		return x->chip < y->chip ? -1 : 1;
+	return x->order - y->order;
+}
+
+/* Split the list, resolve every entry, and sort by chip.  Returns the
+ * number of entries or -1. */
+static int dio_parse(int model, char *list, struct dio_ent *ents,
+  int with_values)
+{
+	char *tok, *save, *eq;
+	int i, j, n = 0;
+
+	for (tok = strtok_r(list, ",", &save); tok;
+	  tok = strtok_r(NULL, ",", &save)) {
+		if (n == DIO_MAX_LINES) {
+			fprintf(stderr, "At most %d DIO lines at once\n",
+			  DIO_MAX_LINES);
+			return -1;
+		}
+
+		eq = strchr(tok, '=');
+		if (with_values) {
+			if (!eq || (strcmp(eq + 1, "0") && strcmp(eq + 1, "1"))) {
+				fprintf(stderr, "DIO \"%s\" needs =0 or =1\n",
+				  tok);
+				return -1;
+			}
+			*eq = '\0';
+			ents[n].value = eq[1] - '0';
+		} else if (eq) {
+			fprintf(stderr, "Unexpected value in \"%s\"\n", tok);
+			return -1;
+		}
+
+		ents[n].name = tok;
+		ents[n].order = n;
+		if (dio_resolve(model, &ents[n]))
+			return -1;
+		n++;
+	}
+
+	if (n == 0) {
+		fprintf(stderr, "No DIO lines given\n");
+		return -1;
+	}
+
+	qsort(ents, n, sizeof(*ents), dio_cmp);
+
+	/* A line can only be requested once per request */
+	for (i = 0; i < n; i++) {
+		for (j = i + 1; j < n && ents[j].chip == ents[i].chip; j++) {
+			if (ents[j].offset == ents[i].offset) {
+				fprintf(stderr, "\"%s\" and \"%s\" are the same "
+				  "line\n", ents[i].name, ents[j].name);
+				return -1;
+			}
+		}
+	}
+
+	return n;
+}
+
+/* Open the chip for ents[first] and get the lines of every following
+ * entry on that chip.  Returns the number of entries in the group. */
+static int dio_group(struct dio_ent *ents, int first, int n,
+  struct gpiod_chip **chip, struct gpiod_line_bulk *bulk)
+{
+	unsigned int offsets[DIO_MAX_LINES];
+	int i, count = 0;
+
+	for (i = first; i < n && ents[i].chip == ents[first].chip; i++)
+		offsets[count++] = ents[i].offset;
+
+	*chip = gpiod_chip_open_by_number(ents[first].chip);
+	if (!*chip) {
+		fprintf(stderr, "gpiochip%u: %s\n", ents[first].chip,
+		  strerror(errno));
+		return -1;
+	}
+
+	gpiod_line_bulk_init(bulk);
+	if (gpiod_chip_get_lines(*chip, offsets, count, bulk)) {
+		fprintf(stderr, "gpiochip%u: %s\n", ents[first].chip,
+		  strerror(errno));
+		gpiod_chip_close(*chip);
+		return -1;
+	}
+
+	return count;
+}
+
+int dio_set(int model, char *list)
+{
+	struct dio_ent ents[DIO_MAX_LINES];
+	struct gpiod_line_bulk bulk;
+	struct gpiod_chip *chip;
+	int values[DIO_MAX_LINES];
+	int i, j, n, count;
+
+	n = dio_parse(model, list, ents, 1);
+	if (n < 0)
+		return -1;
+
+	for (i = 0; i < n; i += count) {
+		count = dio_group(ents, i, n, &chip, &bulk);
+		if (count < 0)
+			return -1;
+
+		/* The request sets the values, no separate write is needed */
+		for (j = 0; j < count; j++)
+			values[j] = ents[i + j].value;
+		if (gpiod_line_request_bulk_output(&bulk, CONSUMER, values)) {
+			fprintf(stderr, "gpiochip%u: %s\n", ents[i].chip,
+			  strerror(errno));
+			gpiod_chip_close(chip);
+			return -1;
+		}
+		stats_add(STATS_GPIO_WRITE, count);
+		stats_inc(STATS_SYSCALLS);
+		gpiod_chip_close(chip);
+	}
+
+	return 0;
+}
+
+int dio_get(int model, char *list, FILE *out)
+{
+	struct dio_ent ents[DIO_MAX_LINES];
+	struct gpiod_line_bulk bulk;
+	struct gpiod_chip *chip;
+	const char *names[DIO_MAX_LINES];
+	int values[DIO_MAX_LINES], result[DIO_MAX_LINES];
+	int i, j, n, count;
+
+	n = dio_parse(model, list, ents, 0);
+	if (n < 0)
+		return -1;
+
+	for (i = 0; i < n; i += count) {
+		count = dio_group(ents, i, n, &chip, &bulk);
+		if (count < 0)
+			return -1;
+
+		if (gpiod_line_request_bulk_input(&bulk, CONSUMER) ||
+		  gpiod_line_get_value_bulk(&bulk, values)) {
+			fprintf(stderr, "gpiochip%u: %s\n", ents[i].chip,
+			  strerror(errno));
+			gpiod_chip_close(chip);
+			return -1;
+		}
+		stats_add(STATS_GPIO_READ, count);
+		stats_add(STATS_SYSCALLS, 2);
+		gpiod_chip_close(chip);
+
+		for (j = 0; j < count; j++) {
+			names[ents[i + j].order] = ents[i + j].name;
+			result[ents[i + j].order] = values[j];
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		fprintf(out, "%s=%d\n", names[i], result[i]);
+
+	return 0;
+}
+
+static int dio_in_board(int model, const char *name)
+{
+	int i;
+
+	for (i = 0; i < sizeof(dio_board)/sizeof(dio_board[0]); i++)
+		if (dio_board[i].model == model &&
+		  !strcasecmp(dio_board[i].name, name))
+			return 1;
+	return 0;
+}
+
+void dio_list(int model, FILE *out)
+{
+	struct gpiod_chip *chip;
+	struct gpiod_line *line;
+	const char *name;
+	unsigned int n, i;
+
+	for (i = 0; i < sizeof(dio_board)/sizeof(dio_board[0]); i++)
+		if (dio_board[i].model == model)
+			fprintf(out, "%s chip%u:%u\n", dio_board[i].name,
+			  dio_board[i].chip, dio_board[i].offset);
+
+	/* Then every line the device tree names, such as the DIO header */
+	for (n = 0; (chip = gpiod_chip_open_by_number(n)) != NULL; n++) {
+		for (i = 0; i < gpiod_chip_num_lines(chip); i++) {
+			line = gpiod_chip_get_line(chip, i);
+			name = line ? gpiod_line_name(line) : NULL;
+			if (name && !dio_in_board(model, name))
+				fprintf(out, "%s chip%u:%u\n", name, n, i);
+		}
+		gpiod_chip_close(chip);
+	}
+}
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __DIO_H__
+#define __DIO_H__
+
+#include <stdio.h>
+
+/* Most lines accepted in one --dio-get or --dio-set list */
+#define DIO_MAX_LINES	64
+
+/* A list is comma separated.  Each entry names a line as one of:
+ *  a name from the board table for this model
+ *  a line name known to the kernel, as gpioinfo shows them
+ *  chipN:offset, for /dev/gpiochipN
+ * For dio_set() each entry is followed by =0 or =1.
+ *
+ * Lines are grouped by gpiochip, and each chip is handled with a single
+ * bulk request, so all lines on a chip change at the same time.  Outputs
+ * keep their value after exit, as with gpioset.
+ *
+ * These return 0, or -1 after printing an error.
+ */
+int dio_set(int model, char *list);
+
+/* Print NAME=value for each line, in the order given */
+int dio_get(int model, char *list, FILE *out);
+
+/* Print the board table for this model, then every line the kernel has
+ * a name for */
+void dio_list(int model, FILE *out);
+
+#endif //__DIO_H__
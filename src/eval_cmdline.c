@@ -42,7 +42,7 @@ void eval_cmd_init(void)
 	}
 
 	cmd_fd = fopen("/proc/cmdline", "r");
-	if ((int32_t)cmd_fd == -1) {
+	if (cmd_fd == NULL) {
 		error(errno, errno, "Failed to open /proc/cmdline");
 	}
 
@@ -63,6 +63,18 @@ void eval_cmd_init(void)
 	fclose(cmd_fd);
 }
 
+/* Use the given string in place of /proc/cmdline, for example to evaluate a
+ * saved command line from another boot.  The string is copied.
+ */
+void eval_cmd_init_str(const char *cmdline)
+{
+	free(cmd_str);
+	cmd_str = strdup(cmdline);
+	if (cmd_str == NULL) {
+		error(errno, errno, "Failed to allocate memory");
+	}
+}
+
 /* Perform the actual evaluation of variable value similar to bash eval 
  * Note that token must be "var" and not "var="
  *
@@ -5,6 +5,7 @@
 #define __EVAL_CMDLINE_H__
 
 void eval_cmd_init(void);
+void eval_cmd_init_str(const char *cmdline);
 int32_t eval_cmd(const char *token);
 
 #endif
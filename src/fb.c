@@ -0,0 +1,151 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <linux/fb.h>
+#include "fb.h"
+
+int fb_open(struct fb *fb, const char *path, int width, int height,
+  int double_buffer)
+{
+	struct fb_var_screeninfo var;
+	struct fb_fix_screeninfo fix;
+	struct stat st;
+
+	memset(fb, 0, sizeof(*fb));
+	fb->fd = open(path, O_RDWR);
+	if (fb->fd == -1) {
+		perror(path);
+		return -1;
+	}
+
+	if (ioctl(fb->fd, FBIOGET_VSCREENINFO, &var) == 0 &&
+	  ioctl(fb->fd, FBIOGET_FSCREENINFO, &fix) == 0) {
+		if (var.bits_per_pixel != 16) {
+			fprintf(stderr, "%s: %d bpp, only RGB565 is supported\n",
+			  path, var.bits_per_pixel);
+			close(fb->fd);
+			return -1;
+		}
+		fb->is_dev = 1;
+		fb->width = var.xres;
+		fb->height = var.yres;
+		fb->stride = fix.line_length;
+		fb->size = fix.smem_len;
+		fb->nbufs = 1;
+		if (double_buffer && var.yres_virtual >= var.yres * 2 &&
+		  fix.ypanstep)
+			fb->nbufs = 2;
+
+		/* Draw where the display is panned to, a double buffered
+		 * tool may have left it on the second page */
+		fb->front = (size_t)var.yoffset * fix.line_length;
+		if (fb->front + (size_t)fb->height * fb->stride > fb->size)
+			fb->front = 0;
+		/* Flipping only alternates between the two whole pages */
+		if (fb->front != 0 &&
+		  fb->front != (size_t)fb->height * fb->stride)
+			fb->nbufs = 1;
+	} else {
+		fb->width = width;
+		fb->height = height;
+		fb->stride = width * 2;
+		fb->size = (size_t)fb->stride * height;
+		fb->nbufs = 1;
+		if (fstat(fb->fd, &st) || (st.st_size < fb->size &&
+		  ftruncate(fb->fd, fb->size))) {
+			perror(path);
+			close(fb->fd);
+			return -1;
+		}
+	}
+
+	fb->mem = mmap(NULL, fb->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	  fb->fd, 0);
+	if (fb->mem == MAP_FAILED) {
+		perror("mmap");
+		close(fb->fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+void fb_close(struct fb *fb)
+{
+	munmap(fb->mem, fb->size);
+	close(fb->fd);
+}
+
+static size_t fb_back_offs(struct fb *fb)
+{
+	if (fb->nbufs < 2)
+		return fb->front;
+	return fb->front ? 0 : (size_t)fb->height * fb->stride;
+}
+
+uint8_t *fb_front(struct fb *fb)
+{
+	return fb->mem + fb->front;
+}
+
+uint8_t *fb_back(struct fb *fb)
+{
+	return fb->mem + fb_back_offs(fb);
+}
+
+int fb_flip(struct fb *fb)
+{
+	struct fb_var_screeninfo var;
+	size_t back = fb_back_offs(fb);
+
+	if (fb->nbufs < 2)
+		return 0;
+
+	if (ioctl(fb->fd, FBIOGET_VSCREENINFO, &var))
+		return -1;
+	var.yoffset = back / fb->stride;
+	if (ioctl(fb->fd, FBIOPAN_DISPLAY, &var))
+		return -1;
+	fb->front = back;
+
+	return 0;
+}
+
+void fb_blit565(uint8_t *dst, int dst_stride, const uint8_t *src,
+  int src_stride, int w, int h, int swap)
+{
+	const uint8_t *s;
+	uint8_t *d;
+	uint32_t v;
+	int x, y;
+
+	for (y = 0; y < h; y++) {
+		s = src + (size_t)y * src_stride;
+		d = dst + (size_t)y * dst_stride;
+		if (!swap) {
+			memcpy(d, s, w * 2);
+			continue;
+		}
+
+		/* Two pixels at a time, byte swapping each 16 bit half */
+		for (x = 0; x + 2 <= w; x += 2) {
+			memcpy(&v, s + x * 2, 4);
+			v = ((v & 0x00ff00ff) << 8) | ((v >> 8) & 0x00ff00ff);
+			memcpy(d + x * 2, &v, 4);
+		}
+		if (x < w) {
+			d[x * 2] = s[x * 2 + 1];
+			d[x * 2 + 1] = s[x * 2];
+		}
+	}
+}
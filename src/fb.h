@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __FB_H__
+#define __FB_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A mapped RGB565 framebuffer.  When the driver has a virtual resolution of
+ * at least twice the visible height, the two halves are used as front and
+ * back buffers and switched by panning.
+ */
+struct fb {
+	int fd;
+	uint8_t *mem;
+	size_t size;
+	int width;
+	int height;
+	int stride;		/* Bytes per line */
+	int nbufs;		/* 2 if panning is available */
+	size_t front;		/* Offset of the page being displayed */
+	int is_dev;
+};
+
+/* Map a framebuffer device, or a regular file standing in for one.  For a
+ * file, width and height give the geometry and the file is grown to fit,
+ * it must already exist.
+ * double_buffer requests panning when the device supports it.
+ *
+ * Returns 0, or -1 with an error printed.
+ */
+int fb_open(struct fb *fb, const char *path, int width, int height,
+  int double_buffer);
+void fb_close(struct fb *fb);
+
+/* Start of the buffer being displayed, or the one that is not.  Without
+ * double buffering both are the displayed page, wherever the driver is
+ * panned to. */
+uint8_t *fb_front(struct fb *fb);
+uint8_t *fb_back(struct fb *fb);
+
+/* Display the back buffer.  Returns 0, or -1 if panning failed. */
+int fb_flip(struct fb *fb);
+
+/* Copy a w x h block of RGB565 pixels.  With swap set the source is
+ * big-endian, as splash-convert writes it, and is byte swapped on the fly
+ * so the pixels are touched exactly once. */
+void fb_blit565(uint8_t *dst, int dst_stride, const uint8_t *src,
+  int src_stride, int w, int h, int swap);
+
+#endif //__FB_H__
@@ -0,0 +1,174 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Blit preconverted RGB565 images, such as splash.out from splash-convert,
+ * straight into the TS-7100 LCD framebuffer.
+ *
+ * Both the image and the framebuffer are mapped, so the only copy made is
+ * the one into video memory, byte swapping big-endian images as it goes.
+ * With panning available the image is drawn into the back buffer and
+ * displayed with a single pan, then also drawn into the new back buffer so
+ * the two stay identical for the next update.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "fb.h"
+
+#define FB_DEFAULT	"/dev/fb0"
+#define SPLASH_W	240
+#define SPLASH_H	320
+
+static void usage(char **argv)
+{
+	fprintf(stderr,
+	  "Usage: %s [OPTION] ... <image>\n"
+	  "Draw a raw RGB565 image into the framebuffer\n"
+	  "\n"
+	  "  -d, --device <path>    Framebuffer device or file, default %s\n"
+	  "  -x, --x <pixels>       Left edge of the image on screen, default 0\n"
+	  "  -y, --y <pixels>       Top edge of the image on screen, default 0\n"
+	  "  -W, --width <pixels>   Image width, default %d\n"
+	  "  -H, --height <pixels>  Image height, default %d\n"
+	  "  -l, --little-endian    Image is native little-endian RGB565, the\n"
+	  "                         default is big-endian as from splash-convert\n"
+	  "  -s, --single           Draw in place even if panning is available\n"
+	  "  -g, --geometry <WxH>   Screen size when the device is a plain file\n"
+	  "  -h, --help             This message\n"
+	  "\n",
+	  argv[0], FB_DEFAULT, SPLASH_W, SPLASH_H
+	);
+}
+
+int main(int argc, char **argv)
+{
+	struct fb fb;
+	struct stat st;
+	const char *device = FB_DEFAULT;
+	const uint8_t *img;
+	int c, fd, x = 0, y = 0, w = SPLASH_W, h = SPLASH_H;
+	int sx = 0, sy = 0, cw, ch;
+	int fw = SPLASH_W, fh = SPLASH_H;
+	int opt_swap = 1, opt_double = 1;
+
+	static struct option long_options[] = {
+	  { "device", required_argument, NULL, 'd' },
+	  { "x", required_argument, NULL, 'x' },
+	  { "y", required_argument, NULL, 'y' },
+	  { "width", required_argument, NULL, 'W' },
+	  { "height", required_argument, NULL, 'H' },
+	  { "little-endian", no_argument, NULL, 'l' },
+	  { "single", no_argument, NULL, 's' },
+	  { "geometry", required_argument, NULL, 'g' },
+	  { "help", no_argument, NULL, 'h' },
+	  { NULL, no_argument, NULL, 0 }
+	};
+
+	while((c = getopt_long(argc, argv, "d:x:y:W:H:lsg:h",
+	  long_options, NULL)) != -1) {
+		switch (c) {
+		  case 'd':
+			device = optarg;
+			break;
+		  case 'x':
+			x = strtol(optarg, NULL, 0);
+			break;
+		  case 'y':
+			y = strtol(optarg, NULL, 0);
+			break;
+		  case 'W':
+			w = strtol(optarg, NULL, 0);
+			break;
+		  case 'H':
+			h = strtol(optarg, NULL, 0);
+			break;
+		  case 'l':
+			opt_swap = 0;
+			break;
+		  case 's':
+			opt_double = 0;
+			break;
+		  case 'g':
+			if (sscanf(optarg, "%dx%d", &fw, &fh) != 2) {
+				usage(argv);
+				return 1;
+			}
+			break;
+		  case 'h':
+		  default:
+			usage(argv);
+			return 1;
+		}
+	}
+
+	if (argc - optind != 1 || w <= 0 || h <= 0) {
+		usage(argv);
+		return 1;
+	}
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd == -1 || fstat(fd, &st)) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (st.st_size < (off_t)w * h * 2) {
+		fprintf(stderr, "%s: smaller than %dx%d RGB565\n", argv[optind],
+		  w, h);
+		return 1;
+	}
+	img = mmap(NULL, (size_t)w * h * 2, PROT_READ, MAP_SHARED, fd, 0);
+	if (img == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	if (fb_open(&fb, device, fw, fh, opt_double))
+		return 1;
+
+	/* Clip to the screen */
+	if (x < 0) {
+		sx = -x;
+		x = 0;
+	}
+	if (y < 0) {
+		sy = -y;
+		y = 0;
+	}
+	cw = w - sx;
+	ch = h - sy;
+	if (x + cw > fb.width)
+		cw = fb.width - x;
+	if (y + ch > fb.height)
+		ch = fb.height - y;
+	if (cw <= 0 || ch <= 0)
+		return 0;
+
+	img += ((size_t)sy * w + sx) * 2;
+	/* The back page may hold an older frame, bring it up to date with
+	 * what is shown so only the image changes on the flip */
+	if (fb.nbufs > 1 && (cw < fb.width || ch < fb.height))
+		memcpy(fb_back(&fb), fb_front(&fb),
+		  (size_t)fb.stride * fb.height);
+	fb_blit565(fb_back(&fb) + (size_t)y * fb.stride + x * 2, fb.stride,
+	  img, w * 2, cw, ch, opt_swap);
+	if (fb.nbufs > 1) {
+		if (fb_flip(&fb)) {
+			perror("FBIOPAN_DISPLAY");
+			return 1;
+		}
+		fb_blit565(fb_back(&fb) + (size_t)y * fb.stride + x * 2,
+		  fb.stride, img, w * 2, cw, ch, opt_swap);
+	}
+
+	fb_close(&fb);
+
+	return 0;
+}
@@ -0,0 +1,427 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Progress bar and animated status icons for the TS-7100 LCD.
+ *
+ * The scene is drawn into a copy in RAM and every drawing operation records
+ * the rectangle it touched.  Once per frame the dirty rectangles are merged
+ * and only those spans are copied into the framebuffer, so a frame where
+ * the bar grows by a pixel and a spinner advances writes a few hundred
+ * bytes rather than the whole 150KB screen.
+ *
+ * Progress is read from stdin as one percentage per line.  The last value
+ * read before each frame is drawn, at a fixed frame rate.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "fb.h"
+#include "rgb565.h"
+
+#define FB_DEFAULT	"/dev/fb0"
+#define SCREEN_W	240
+#define SCREEN_H	320
+#define MAX_DIRTY	16
+#define MAX_ICONS	4
+#define ICON_SZ		24
+#define ICON_DOTS	8
+
+struct rect {
+	int x, y, w, h;
+};
+
+struct scene {
+	uint16_t *px;
+	int width, height;
+	struct rect dirty[MAX_DIRTY];
+	int ndirty;
+};
+
+struct icon {
+	int x, y;
+	int phase;
+};
+
+/* Dot positions around a spinner, 3x3 pixels each */
+static const int8_t dot_pos[ICON_DOTS][2] = {
+	{ 10, 1 }, { 17, 4 }, { 20, 10 }, { 17, 17 },
+	{ 10, 20 }, { 4, 17 }, { 1, 10 }, { 4, 4 },
+};
+
+static void usage(char **argv)
+{
+	fprintf(stderr,
+	  "Usage: %s [OPTION] ...\n"
+	  "Draw a progress bar from percentages read on stdin\n"
+	  "\n"
+	  "  -d, --device <path>    Framebuffer device or file, default %s\n"
+	  "  -g, --geometry <WxH>   Screen size when the device is a plain file\n"
+	  "  -s, --splash <file>    Big-endian RGB565 background, e.g. splash.out\n"
+	  "  -p, --bar <x,y,w,h>    Progress bar position, default 20,280,200,12\n"
+	  "  -i, --icon <x,y>       Add a spinner icon, up to %d\n"
+	  "  -r, --rate <fps>       Frame rate, default 30\n"
+	  "  -b, --bench <frames>   Render a synthetic sequence and report bytes\n"
+	  "                         written per frame\n"
+	  "  -h, --help             This message\n"
+	  "\n",
+	  argv[0], FB_DEFAULT, MAX_ICONS
+	);
+}
+
+static int rect_touch(const struct rect *a, const struct rect *b)
+{
+	return a->x <= b->x + b->w && b->x <= a->x + a->w &&
+	  a->y <= b->y + b->h && b->y <= a->y + a->h;
+}
+
+static void rect_union(struct rect *a, const struct rect *b)
+{
+	int x2 = (a->x + a->w > b->x + b->w) ? a->x + a->w : b->x + b->w;
+	int y2 = (a->y + a->h > b->y + b->h) ? a->y + a->h : b->y + b->h;
+
+	a->x = (a->x < b->x) ? a->x : b->x;
+	a->y = (a->y < b->y) ? a->y : b->y;
+	a->w = x2 - a->x;
+	a->h = y2 - a->y;
+}
+
+/* Record a changed area, merging it with any rectangle it touches.  When
+ * the list is full everything collapses into one bounding box. */
+static void mark_dirty(struct scene *sc, int x, int y, int w, int h)
+{
+	struct rect r = { x, y, w, h };
+	int i;
+
+	if (r.x < 0) {
+		r.w += r.x;
+		r.x = 0;
+	}
+	if (r.y < 0) {
+		r.h += r.y;
+		r.y = 0;
+	}
+	if (r.x + r.w > sc->width)
+		r.w = sc->width - r.x;
+	if (r.y + r.h > sc->height)
+		r.h = sc->height - r.y;
+	if (r.w <= 0 || r.h <= 0)
+		return;
+
+	for (i = 0; i < sc->ndirty; i++) {
+		if (rect_touch(&sc->dirty[i], &r)) {
+			rect_union(&r, &sc->dirty[i]);
+			sc->dirty[i] = sc->dirty[--sc->ndirty];
+			i = -1;
+		}
+	}
+
+	if (sc->ndirty == MAX_DIRTY) {
+		for (i = 1; i < sc->ndirty; i++)
+			rect_union(&sc->dirty[0], &sc->dirty[i]);
+		rect_union(&sc->dirty[0], &r);
+		sc->ndirty = 1;
+		return;
+	}
+	sc->dirty[sc->ndirty++] = r;
+}
+
+static void fill_rect(struct scene *sc, int x, int y, int w, int h,
+  uint16_t color)
+{
+	int i, j;
+
+	if (w <= 0 || h <= 0)
+		return;
+	for (j = y; j < y + h; j++) {
+		if (j < 0 || j >= sc->height)
+			continue;
+		for (i = x; i < x + w; i++)
+			if (i >= 0 && i < sc->width)
+				sc->px[j * sc->width + i] = color;
+	}
+	mark_dirty(sc, x, y, w, h);
+}
+
+/* Copy the dirty spans to the framebuffer.  Returns bytes written. */
+static size_t flush(struct scene *sc, struct fb *fb)
+{
+	size_t bytes = 0;
+	struct rect *r;
+	int i;
+
+	for (i = 0; i < sc->ndirty; i++) {
+		r = &sc->dirty[i];
+		fb_blit565(fb_front(fb) + (size_t)r->y * fb->stride + r->x * 2,
+		  fb->stride, (uint8_t *)&sc->px[r->y * sc->width + r->x],
+		  sc->width * 2, r->w, r->h, 0);
+		bytes += (size_t)r->w * r->h * 2;
+	}
+	sc->ndirty = 0;
+
+	return bytes;
+}
+
+static uint16_t col_bar, col_frame, col_bg, col_dot, col_dim;
+
+static void draw_bar(struct scene *sc, const struct rect *bar, int *shown,
+  int pct)
+{
+	int inner = bar->w - 4;
+	int fill = inner * pct / 100;
+
+	if (*shown < 0) {
+		/* First frame, draw the frame and the empty bar */
+		fill_rect(sc, bar->x, bar->y, bar->w, bar->h, col_frame);
+		fill_rect(sc, bar->x + 2, bar->y + 2, inner, bar->h - 4,
+		  col_bg);
+		*shown = 0;
+	}
+
+	/* Only the columns between the old and new fill change */
+	if (fill > *shown)
+		fill_rect(sc, bar->x + 2 + *shown, bar->y + 2, fill - *shown,
+		  bar->h - 4, col_bar);
+	else if (fill < *shown)
+		fill_rect(sc, bar->x + 2 + fill, bar->y + 2, *shown - fill,
+		  bar->h - 4, col_bg);
+	*shown = fill;
+}
+
+static void draw_icon(struct scene *sc, struct icon *ic, int first)
+{
+	int i;
+
+	if (first) {
+		fill_rect(sc, ic->x, ic->y, ICON_SZ, ICON_SZ, col_bg);
+		for (i = 0; i < ICON_DOTS; i++)
+			fill_rect(sc, ic->x + dot_pos[i][0],
+			  ic->y + dot_pos[i][1], 3, 3, col_dim);
+	}
+
+	/* Move the bright dot on by one */
+	fill_rect(sc, ic->x + dot_pos[ic->phase][0],
+	  ic->y + dot_pos[ic->phase][1], 3, 3, col_dim);
+	ic->phase = (ic->phase + 1) % ICON_DOTS;
+	fill_rect(sc, ic->x + dot_pos[ic->phase][0],
+	  ic->y + dot_pos[ic->phase][1], 3, 3, col_dot);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Read whatever input is pending, keeping the last complete percentage.
+ * Returns -1 on end of input. */
+static int read_progress(int *pct)
+{
+	static char line[32];
+	static int len;
+	struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+	char buf[256];
+	ssize_t n, i;
+
+	while (poll(&pfd, 1, 0) == 1) {
+		n = read(STDIN_FILENO, buf, sizeof(buf));
+		if (n <= 0) {
+			if (n == -1 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		for (i = 0; i < n; i++) {
+			if (buf[i] == '\n') {
+				line[len] = 0;
+				*pct = atoi(line);
+				len = 0;
+			} else if (len < sizeof(line) - 1) {
+				line[len++] = buf[i];
+			}
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct fb fb;
+	struct scene sc;
+	struct rect bar = { 20, 280, 200, 12 };
+	struct icon icons[MAX_ICONS];
+	struct timespec deadline;
+	const char *device = FB_DEFAULT, *splash = NULL;
+	uint64_t next, start, frame_ns;
+	size_t bytes, first = 0, total = 0, max = 0;
+	int c, i, fw = SCREEN_W, fh = SCREEN_H, nicons = 0, rate = 30;
+	int pct = 0, shown = -1, frames = 0, bench = 0, eof = 0;
+
+	static struct option long_options[] = {
+	  { "device", required_argument, NULL, 'd' },
+	  { "geometry", required_argument, NULL, 'g' },
+	  { "splash", required_argument, NULL, 's' },
+	  { "bar", required_argument, NULL, 'p' },
+	  { "icon", required_argument, NULL, 'i' },
+	  { "rate", required_argument, NULL, 'r' },
+	  { "bench", required_argument, NULL, 'b' },
+	  { "help", no_argument, NULL, 'h' },
+	  { NULL, no_argument, NULL, 0 }
+	};
+
+	while((c = getopt_long(argc, argv, "d:g:s:p:i:r:b:h",
+	  long_options, NULL)) != -1) {
+		switch (c) {
+		  case 'd':
+			device = optarg;
+			break;
+		  case 'g':
+			if (sscanf(optarg, "%dx%d", &fw, &fh) != 2) {
+				usage(argv);
+				return 1;
+			}
+			break;
+		  case 's':
+			splash = optarg;
+			break;
+		  case 'p':
+			if (sscanf(optarg, "%d,%d,%d,%d", &bar.x, &bar.y, &bar.w,
+			  &bar.h) != 4 || bar.w < 5 || bar.h < 5) {
+				usage(argv);
+				return 1;
+			}
+			break;
+		  case 'i':
+			if (nicons == MAX_ICONS || sscanf(optarg, "%d,%d",
+			  &icons[nicons].x, &icons[nicons].y) != 2) {
+				usage(argv);
+				return 1;
+			}
+			icons[nicons++].phase = 0;
+			break;
+		  case 'r':
+			rate = atoi(optarg);
+			break;
+		  case 'b':
+			bench = atoi(optarg);
+			break;
+		  case 'h':
+		  default:
+			usage(argv);
+			return 1;
+		}
+	}
+
+	if (rate <= 0 || rate > 1000) {
+		fprintf(stderr, "Frame rate must be 1-1000\n");
+		return 1;
+	}
+
+	if (fb_open(&fb, device, fw, fh, 0))
+		return 1;
+
+	sc.width = fb.width;
+	sc.height = fb.height;
+	sc.ndirty = 0;
+	sc.px = calloc((size_t)sc.width * sc.height, sizeof(uint16_t));
+	if (!sc.px) {
+		perror("calloc");
+		return 1;
+	}
+
+	col_bar = rgb565_pack(0x20, 0xc0, 0x40);
+	col_frame = rgb565_pack(0xc0, 0xc0, 0xc0);
+	col_bg = rgb565_pack(0x00, 0x00, 0x00);
+	col_dot = rgb565_pack(0xff, 0xff, 0xff);
+	col_dim = rgb565_pack(0x40, 0x40, 0x40);
+
+	/* The background is the only full screen write */
+	if (splash) {
+		struct stat st;
+		uint8_t *img;
+		int fd = open(splash, O_RDONLY);
+
+		if (fd == -1 || fstat(fd, &st) ||
+		  st.st_size < (off_t)sc.width * sc.height * 2) {
+			fprintf(stderr, "%s: not a %dx%d RGB565 image\n", splash,
+			  sc.width, sc.height);
+			return 1;
+		}
+		img = malloc(st.st_size);
+		if (!img || read(fd, img, st.st_size) != st.st_size) {
+			perror(splash);
+			return 1;
+		}
+		close(fd);
+		fb_blit565((uint8_t *)sc.px, sc.width * 2, img, sc.width * 2,
+		  sc.width, sc.height, 1);
+		free(img);
+		mark_dirty(&sc, 0, 0, sc.width, sc.height);
+	}
+
+	frame_ns = 1000000000ULL / rate;
+	start = next = now_ns();
+	while (1) {
+		if (bench) {
+			if (frames == bench)
+				break;
+			pct = frames * 100 / bench;
+		} else if (!eof && read_progress(&pct)) {
+			eof = 1;
+		}
+		if (pct < 0)
+			pct = 0;
+		if (pct > 100)
+			pct = 100;
+
+		draw_bar(&sc, &bar, &shown, pct);
+		for (i = 0; i < nicons; i++)
+			draw_icon(&sc, &icons[i], frames == 0);
+
+		bytes = flush(&sc, &fb);
+		if (frames == 0)
+			first = bytes;
+		else
+			total += bytes;
+		if (frames && bytes > max)
+			max = bytes;
+		frames++;
+
+		/* Finish once the final value has been drawn */
+		if (eof)
+			break;
+
+		if (bench)
+			continue;
+
+		next += frame_ns;
+		deadline.tv_sec = next / 1000000000ULL;
+		deadline.tv_nsec = next % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+		  &deadline, NULL) == EINTR);
+	}
+
+	/* The first frame draws everything, report it separately from the
+	 * steady state */
+	if (bench) {
+		printf("frames=%d full_frame_bytes=%d first_frame_bytes=%zu "
+		  "avg_bytes_per_frame=%zu max_bytes_per_frame=%zu "
+		  "us_per_frame=%.1f\n", frames, sc.width * sc.height * 2,
+		  first, frames > 1 ? total / (frames - 1) : 0, max,
+		  frames ? (now_ns() - start) / 1000.0 / frames : 0.0);
+	}
+
+	fb_close(&fb);
+
+	return 0;
+}
@@ -6,6 +6,11 @@
  *
  * This implementation assumes all accesses must be 32 or 16 bit aligned, and
  * 32 or 16 bits wide.
+ *
+ * The syscon page is mapped through /dev/mem by default, which needs root.
+ * Setting TS_FPGA_PATH to a UIO device, a sysfs resource file, or a plain
+ * file standing in for one maps that instead, from its start.  Further
+ * windows, such as FPGA buffer RAM, can be mapped with fpga_map().
  */
 
 #include <assert.h>
@@ -14,31 +19,192 @@
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include "fpga.h"
+#include "stats.h"
 
 static volatile void *fpgaregs = NULL;
 static int devmemfd;
 
+/* Map a register window from an already open file.  This is normally
+ * /dev/mem, but any file with the same layout works, such as a memfd
+ * standing in for the FPGA when benchmarking on a host.
+ */
+void fpga_init_fd(int fd, off_t base)
+{
+	void *map;
+
+	if (fpgaregs != NULL) {
+		return;
+	}
+
+	map = mmap(0, getpagesize(),
+          PROT_READ | PROT_WRITE, MAP_SHARED, fd, base);
+	if (map == MAP_FAILED) {
+		close(fd);
+		error(errno, errno, "Unable to map address space for FPGA");
+	}
+
+	devmemfd = fd;
+	fpgaregs = map;
+	stats_inc(STATS_SYSCALLS);
+}
+
 void fpga_init(size_t base)
 {
+	struct fpga_window win;
+	const char *path = getenv("TS_FPGA_PATH");
+	int fd;
+
 	if (fpgaregs != NULL) {
 		return;
 	}
 
-	devmemfd = open("/dev/mem", O_RDWR|O_SYNC);
-	if (devmemfd == -1) {
+	if (path != NULL) {
+		if (fpga_map(&win, path, strcmp(path, "/dev/mem") ? 0 : base,
+		  getpagesize(), FPGA_MAP_UNCACHED)) {
+			exit(1);
+		}
+		devmemfd = win.fd;
+		fpgaregs = win.regs;
+		return;
+	}
+
+	fd = open("/dev/mem", O_RDWR|O_SYNC);
+	if (fd == -1) {
 		error(errno, errno, "Unable to open /dev/mem for FPGA access");
 	}
+	stats_inc(STATS_SYSCALLS);
 
-	fpgaregs = mmap(0, getpagesize(),
-          PROT_READ | PROT_WRITE, MAP_SHARED, devmemfd, base);
-	if ((int32_t)fpgaregs == -1) {
-		close(devmemfd);
-		error(errno, errno, "Unable to map address space for FPGA");
+	fpga_init_fd(fd, base);
+}
+
+/* Size of UIO map n, from sysfs */
+static size_t uio_map_size(const char *path, int n)
+{
+	char sysfs[256];
+	unsigned long long size = 0;
+	FILE *f;
+
+	snprintf(sysfs, sizeof(sysfs), "/sys/class/uio/%s/maps/map%d/size",
+	  strrchr(path, '/') + 1, n);
+	f = fopen(sysfs, "r");
+	if (f == NULL)
+		return 0;
+	if (fscanf(f, "%llx", &size) != 1)
+		size = 0;
+	fclose(f);
+
+	return size;
+}
+
+/* The cache attributes of a mapping are decided by the node it comes from.
+ * /dev/mem opened O_SYNC and UIO maps are always uncached.  A PCI sysfs
+ * resourceN file has a resourceN_wc twin that maps write-combined.
+ */
+int fpga_map(struct fpga_window *win, const char *path, off_t offset,
+  size_t size, int flags)
+{
+	char node[256];
+	struct stat st;
+	int is_uio = !strncmp(path, "/dev/uio", 8);
+	int is_sysfs = !strncmp(path, "/sys/", 5);
+	const char *suffix = "";
+	void *map;
+
+	if (flags & FPGA_MAP_WC) {
+		if (is_sysfs) {
+			if (strcmp(path + strlen(path) - 3, "_wc"))
+				suffix = "_wc";
+		} else if (is_uio || !strcmp(path, "/dev/mem")) {
+			fprintf(stderr, "%s: write-combining is not available, "
+			  "use a sysfs resource file\n", path);
+			return -1;
+		}
+	}
+	snprintf(node, sizeof(node), "%s%s", path, suffix);
+
+	win->fd = open(node, O_RDWR | O_CLOEXEC |
+	  (strcmp(path, "/dev/mem") ? 0 : O_SYNC));
+	if (win->fd == -1) {
+		fprintf(stderr, "Unable to open %s for FPGA access: %s\n", node,
+		  strerror(errno));
+		return -1;
+	}
+	stats_inc(STATS_SYSCALLS);
+
+	/* UIO selects map n with an offset of n pages */
+	if (size == 0 && is_uio)
+		size = uio_map_size(path, offset / getpagesize());
+	if (size == 0 && !fstat(win->fd, &st) && S_ISREG(st.st_mode))
+		size = st.st_size - offset;
+	if (size == 0 || size > SIZE_MAX / 2) {
+		fprintf(stderr, "%s: unable to determine window size\n", node);
+		close(win->fd);
+		return -1;
+	}
+
+	map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, win->fd,
+	  offset);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Unable to map %s for FPGA access: %s\n", node,
+		  strerror(errno));
+		close(win->fd);
+		return -1;
 	}
+	stats_inc(STATS_SYSCALLS);
+
+	win->regs = map;
+	win->size = size;
+	win->flags = flags;
+
+	return 0;
+}
+
+void fpga_unmap(struct fpga_window *win)
+{
+	munmap((void *)win->regs, win->size);
+	close(win->fd);
+	win->regs = NULL;
+}
+
+/* Bulk copies use 32-bit accesses only.  On a write-combined window the
+ * CPU merges them into bursts, fpga_window_flush() makes them visible. */
+void fpga_window_write(struct fpga_window *win, size_t offs,
+  const uint32_t *src, size_t count)
+{
+	volatile uint32_t *dst = (volatile uint32_t *)(win->regs + offs);
+
+	assert((offs & 0x3) == 0);
+	assert(offs + count * 4 <= win->size);
+
+	stats_add(STATS_FPGA_WRITE32, count);
+	while (count--)
+		*dst++ = *src++;
+}
+
+void fpga_window_read(struct fpga_window *win, size_t offs, uint32_t *dst,
+  size_t count)
+{
+	volatile uint32_t *src = (volatile uint32_t *)(win->regs + offs);
+
+	assert((offs & 0x3) == 0);
+	assert(offs + count * 4 <= win->size);
+
+	stats_add(STATS_FPGA_READ32, count);
+	while (count--)
+		*dst++ = *src++;
+}
+
+void fpga_window_flush(struct fpga_window *win)
+{
+	if (win->flags & FPGA_MAP_WC)
+		__sync_synchronize();
 }
 
 void fpoke16(size_t offs, uint16_t value)
@@ -47,6 +213,7 @@ void fpoke16(size_t offs, uint16_t value)
 	assert(offs < getpagesize());
 	assert((offs & 0x1) == 0);
 
+	stats_inc(STATS_FPGA_WRITE16);
 	*(volatile uint16_t *)(fpgaregs+offs) = value;
 }
 
@@ -56,6 +223,7 @@ uint16_t fpeek16(size_t offs)
 	assert(offs < getpagesize());
 	assert((offs & 0x1) == 0);
 
+	stats_inc(STATS_FPGA_READ16);
 	return *(volatile uint16_t *)(fpgaregs+offs);
 }
 
@@ -65,6 +233,7 @@ void fpoke32(size_t offs, uint32_t value)
 	assert(offs < getpagesize());
 	assert((offs & 0x3) == 0);
 
+	stats_inc(STATS_FPGA_WRITE32);
 	*(volatile uint32_t *)(fpgaregs+offs) = value;
 }
 
@@ -74,5 +243,6 @@ uint32_t fpeek32(size_t offs)
 	assert(offs < getpagesize());
 	assert((offs & 0x3) == 0);
 
+	stats_inc(STATS_FPGA_READ32);
 	return *(volatile uint32_t *)(fpgaregs+offs);
 }
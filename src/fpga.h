@@ -4,10 +4,44 @@
 #ifndef __FPGA_H_
 #define __FPGA_H_
 
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Cache attribute for fpga_map() */
+#define FPGA_MAP_UNCACHED	0
+#define FPGA_MAP_WC		(1 << 0)
+
+struct fpga_window {
+	volatile void *regs;
+	size_t size;
+	int fd;
+	int flags;
+};
+
 void fpga_init(size_t base);
+void fpga_init_fd(int fd, off_t base);
 void fpoke16(size_t offs, uint16_t value);
 uint16_t fpeek16(size_t offs);
 void fpoke32(size_t offs, uint32_t value);
 uint32_t fpeek32(size_t offs);
 
+/* Map size bytes at offset of path, which may be /dev/mem, /dev/uioN, a
+ * sysfs resource file, or a regular file.  A size of 0 maps the whole UIO
+ * map or file.  FPGA_MAP_WC selects the resourceN_wc node of a sysfs
+ * resource and fails for nodes that cannot be write-combined.
+ *
+ * Returns 0, or -1 with an error printed.
+ */
+int fpga_map(struct fpga_window *win, const char *path, off_t offset,
+  size_t size, int flags);
+void fpga_unmap(struct fpga_window *win);
+
+void fpga_window_write(struct fpga_window *win, size_t offs,
+  const uint32_t *src, size_t count);
+void fpga_window_read(struct fpga_window *win, size_t offs, uint32_t *dst,
+  size_t count);
+
+/* Order write-combined writes before anything that follows */
+void fpga_window_flush(struct fpga_window *win);
+
 #endif
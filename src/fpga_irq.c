@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Wait for FPGA status changes on an interrupt instead of polling.
+ *
+ * A UIO device reads back a 32-bit count of interrupts and blocks until
+ * the count changes.  Drivers with irqcontrol, such as uio_pdrv_genirq,
+ * leave the interrupt disabled after it fires until 1 is written back,
+ * which is done here before every check of the conditions.
+ *
+ * The register conditions are read with fpeek32(), so fpga_init() must
+ * have been called first.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fpga.h"
+#include "fpga_irq.h"
+#include "stats.h"
+
+int fpga_irq_open(struct fpga_irq *irq, const char *path)
+{
+	int fd;
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	stats_inc(STATS_SYSCALLS);
+
+	fpga_irq_open_fd(irq, fd);
+	irq->is_uio = 1;
+
+	return 0;
+}
+
+void fpga_irq_open_fd(struct fpga_irq *irq, int fd)
+{
+	irq->fd = fd;
+	irq->is_uio = 0;
+	irq->count = 0;
+	irq->wakeups = 0;
+}
+
+void fpga_irq_close(struct fpga_irq *irq)
+{
+	close(irq->fd);
+	irq->fd = -1;
+}
+
+/* Re-enable the interrupt.  Drivers without irqcontrol refuse the write,
+ * their interrupt never needs re-arming. */
+static void fpga_irq_arm(struct fpga_irq *irq)
+{
+	int32_t on = 1;
+
+	if (!irq->is_uio)
+		return;
+
+	stats_inc(STATS_SYSCALLS);
+	if (write(irq->fd, &on, sizeof(on)) != sizeof(on))
+		irq->is_uio = 2;
+}
+
+static int fpga_irq_check(const struct fpga_irq_cond *conds, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if ((fpeek32(conds[i].offs) & conds[i].mask) == conds[i].value)
+			return i;
+
+	return -1;
+}
+
+static int64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int fpga_irq_wait(struct fpga_irq *irq, const struct fpga_irq_cond *conds,
+  int n, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = irq->fd, .events = POLLIN };
+	int64_t deadline = now_ms() + timeout_ms;
+	uint32_t count32;
+	uint64_t count64;
+	int ret, wait;
+
+	while (1) {
+		if (irq->is_uio == 1)
+			fpga_irq_arm(irq);
+
+		ret = fpga_irq_check(conds, n);
+		if (ret >= 0)
+			return ret;
+
+		wait = -1;
+		if (timeout_ms >= 0) {
+			wait = deadline - now_ms();
+			if (wait <= 0) {
+				errno = ETIMEDOUT;
+				return -1;
+			}
+		}
+
+		stats_inc(STATS_SYSCALLS);
+		ret = poll(&pfd, 1, wait);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0)
+			continue;
+
+		/* Consume the event so the next poll blocks again */
+		stats_inc(STATS_SYSCALLS);
+		if (irq->is_uio) {
+			ret = read(irq->fd, &count32, sizeof(count32));
+			count64 = count32;
+		} else {
+			count64 = 0;
+			ret = read(irq->fd, &count64, sizeof(count64));
+		}
+		if (ret == -1) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return -1;
+		}
+		irq->count = count64;
+		irq->wakeups++;
+	}
+}
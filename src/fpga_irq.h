@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __FPGA_IRQ_H__
+#define __FPGA_IRQ_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct fpga_irq {
+	int fd;
+	int is_uio;		/* Count reads are 32-bit and need re-arming */
+	uint64_t count;		/* Last interrupt count read */
+	unsigned long wakeups;
+};
+
+/* Satisfied when (fpeek32(offs) & mask) == value */
+struct fpga_irq_cond {
+	size_t offs;
+	uint32_t mask;
+	uint32_t value;
+};
+
+/* Open a UIO device such as /dev/uio0.  Returns 0, or -1 with errno set. */
+int fpga_irq_open(struct fpga_irq *irq, const char *path);
+
+/* Use any pollable fd that becomes readable on an event, such as an
+ * eventfd, in place of a UIO device.  Each read consumes the pending
+ * events and returns a count of up to 8 bytes. */
+void fpga_irq_open_fd(struct fpga_irq *irq, int fd);
+
+void fpga_irq_close(struct fpga_irq *irq);
+
+/* Block until one of the n conditions holds, checking them again after
+ * every interrupt.  The interrupt is re-armed before the conditions are
+ * checked, so an event between the check and the wait is never missed.
+ * timeout_ms of -1 waits forever.
+ *
+ * Returns the index of the condition that holds, or -1 with errno set,
+ * ETIMEDOUT if the timeout expired.
+ */
+int fpga_irq_wait(struct fpga_irq *irq, const struct fpga_irq_cond *conds,
+  int n, int timeout_ms);
+
+#endif //__FPGA_IRQ_H__
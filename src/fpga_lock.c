@@ -0,0 +1,224 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Cross-process lock for read-modify-write of the syscon page.
+ *
+ * Every tool maps the same registers, so two processes changing different
+ * bits of one register can each write back a stale copy of the other's
+ * bits.  The lock is a process-shared robust pthread mutex in a POSIX
+ * shared memory object.  glibc implements it on a futex, so taking and
+ * releasing it uncontended is an atomic operation each, with no syscalls.
+ *
+ * If a holder exits without unlocking, the next locker recovers the mutex.
+ * The registers are left as that holder left them, a sequence it had only
+ * partly written is not rolled back.
+ */
+
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fpga.h"
+#include "fpga_lock.h"
+#include "stats.h"
+
+#define LOCK_NEW	0
+#define LOCK_INIT	1
+#define LOCK_READY	2
+
+struct fpga_lock_shm {
+	uint32_t state;
+	uint32_t size;		/* Guards against a layout from another build */
+	pthread_mutex_t mutex;
+	struct fpga_lock_stats st;
+};
+
+static struct fpga_lock_shm *lk;
+static int lock_tried;
+
+int fpga_lock_open(const char *name)
+{
+	struct fpga_lock_shm *shm;
+	pthread_mutexattr_t attr;
+	struct stat st;
+	int fd, tries;
+
+	lock_tried = 1;
+
+	/* Only the owner may open it, anyone who can map the mutex can also
+	 * hold it forever and stall every read-modify-write */
+	fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+	if (fd == -1) {
+		fprintf(stderr, "FPGA lock %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+	stats_inc(STATS_SYSCALLS);
+
+	/* Nor use one that another user created first */
+	if (fstat(fd, &st) || st.st_uid != geteuid() ||
+	  (st.st_mode & (S_IRWXG | S_IRWXO))) {
+		fprintf(stderr, "FPGA lock %s is not private to this user, "
+		  "remove it from /dev/shm\n", name);
+		close(fd);
+		return -1;
+	}
+
+	/* Growing is harmless if another process just did the same */
+	if (ftruncate(fd, sizeof(*shm))) {
+		fprintf(stderr, "FPGA lock %s: %s\n", name, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED,
+	  fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		fprintf(stderr, "FPGA lock %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+
+	/* The first process to see a zeroed object initializes the mutex */
+	if (__sync_bool_compare_and_swap(&shm->state, LOCK_NEW, LOCK_INIT)) {
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+		pthread_mutex_init(&shm->mutex, &attr);
+		pthread_mutexattr_destroy(&attr);
+		shm->size = sizeof(*shm);
+		__sync_synchronize();
+		shm->state = LOCK_READY;
+	}
+
+	/* Bounded, a process that died mid-init must not hang everyone */
+	for (tries = 0; *(volatile uint32_t *)&shm->state != LOCK_READY;
+	  tries++) {
+		if (tries == 1000) {
+			fprintf(stderr, "FPGA lock %s was never initialized, "
+			  "remove it from /dev/shm\n", name);
+			munmap(shm, sizeof(*shm));
+			return -1;
+		}
+		usleep(1000);
+	}
+	__sync_synchronize();
+
+	if (shm->size != sizeof(*shm)) {
+		fprintf(stderr, "FPGA lock %s has a different layout\n", name);
+		munmap(shm, sizeof(*shm));
+		return -1;
+	}
+
+	lk = shm;
+
+	return 0;
+}
+
+/* Open the default lock on first use.  Returns 0 if there is no lock. */
+static int lock_ready(void)
+{
+	const char *name;
+
+	if (lk == NULL && !lock_tried) {
+		name = getenv("TS_FPGA_LOCK");
+		fpga_lock_open(name ? name : FPGA_LOCK_NAME);
+	}
+
+	return lk != NULL;
+}
+
+void fpga_lock(void)
+{
+	struct stats_mark m;
+	int ret, contended = 0;
+
+	if (!lock_ready())
+		return;
+
+	ret = pthread_mutex_trylock(&lk->mutex);
+	if (ret == EBUSY) {
+		contended = 1;
+		stats_begin(&m);
+		ret = pthread_mutex_lock(&lk->mutex);
+		stats_end(STATS_FPGA_LOCK_WAIT, &m);
+	}
+	if (ret == EOWNERDEAD) {
+		pthread_mutex_consistent(&lk->mutex);
+		lk->st.owner_died++;
+		ret = 0;
+	}
+	if (ret)
+		error(ret, ret, "Unable to take FPGA lock");
+
+	lk->st.acquired++;
+	stats_inc(STATS_FPGA_LOCKS);
+	if (contended) {
+		lk->st.contended++;
+		stats_inc(STATS_FPGA_LOCK_CONTENDED);
+	}
+}
+
+void fpga_unlock(void)
+{
+	if (lk)
+		pthread_mutex_unlock(&lk->mutex);
+}
+
+int fpga_transaction(int (*fn)(void *arg), void *arg)
+{
+	int ret;
+
+	fpga_lock();
+	ret = fn(arg);
+	fpga_unlock();
+
+	return ret;
+}
+
+uint32_t fpga_rmw32(size_t offs, uint32_t mask, uint32_t value)
+{
+	uint32_t val;
+
+	fpga_lock();
+	val = value;
+	if (mask != 0xffffffff)
+		val = (fpeek32(offs) & ~mask) | (value & mask);
+	fpoke32(offs, val);
+	fpga_unlock();
+
+	return val;
+}
+
+uint16_t fpga_rmw16(size_t offs, uint16_t mask, uint16_t value)
+{
+	uint16_t val;
+
+	fpga_lock();
+	val = value;
+	if (mask != 0xffff)
+		val = (fpeek16(offs) & ~mask) | (value & mask);
+	fpoke16(offs, val);
+	fpga_unlock();
+
+	return val;
+}
+
+int fpga_lock_stats(struct fpga_lock_stats *st)
+{
+	if (!lock_ready())
+		return -1;
+
+	fpga_lock();
+	*st = lk->st;
+	fpga_unlock();
+
+	return 0;
+}
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __FPGA_LOCK_H__
+#define __FPGA_LOCK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* POSIX shared memory object holding the lock, TS_FPGA_LOCK overrides.
+ * It is created mode 0600, so only processes of the user that created it,
+ * in practice root as the FPGA registers need, can take the lock. */
+#define FPGA_LOCK_NAME	"/ts-fpga-lock"
+
+/* Totals over every process that has used the lock */
+struct fpga_lock_stats {
+	uint64_t acquired;
+	uint64_t contended;	/* Had to wait for another holder */
+	uint64_t owner_died;	/* Recovered from a holder that exited */
+};
+
+/* Open or create the named lock.  fpga_lock() does this on first use with
+ * the default name, so this is only needed to use another one.  Returns 0,
+ * or -1 with an error printed, after which locking does nothing. */
+int fpga_lock_open(const char *name);
+
+/* Serialize syscon accesses between processes.  The lock is recursive
+ * within a thread, and is released if the holder dies. */
+void fpga_lock(void);
+void fpga_unlock(void);
+
+/* Run fn(arg) with the lock held, returning its result */
+int fpga_transaction(int (*fn)(void *arg), void *arg);
+
+/* Replace the bits of mask in a register under the lock.  With every bit
+ * in mask the register is written without being read first.  Returns the
+ * value written. */
+uint32_t fpga_rmw32(size_t offs, uint32_t mask, uint32_t value);
+uint16_t fpga_rmw16(size_t offs, uint16_t mask, uint16_t value);
+
+/* Returns 0, or -1 if the lock could not be opened */
+int fpga_lock_stats(struct fpga_lock_stats *st);
+
+#endif //__FPGA_LOCK_H__
@@ -0,0 +1,488 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* TS-7250-V3 front panel daemon, the keypad and character LCD driven from
+ * one epoll loop.
+ *
+ * The keypad is scanned on a periodic timerfd.  Any change in the raw scan
+ * restarts a one-shot debounce timerfd, and when that expires the keys
+ * still held are reported.  Display updates arrive on the lcdmesg socket,
+ * so lcdmesg clients hand their updates to this daemon unchanged.
+ *
+ * With a menu loaded, 2ND opens it.  UP and DOWN move the selection, ENTER
+ * runs the selected command and CLEAR closes the menu.  The menu is drawn
+ * from the key event itself, and while it is open application updates are
+ * kept and shown again when it closes.  All other keys are printed to
+ * stdout one per line, as keypad does.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include "hd44780.h"
+#include "helpers.h"
+#include "keypad_scan.h"
+#include "lcdsock.h"
+#include "rt.h"
+#include "stats.h"
+
+#define SCAN_MS		10
+#define DEBOUNCE_MS	50
+#define MENU_MAX	32
+#define ROW_TEXT_MAX	256
+
+enum panel_fd {
+	PANEL_SCAN,
+	PANEL_DEBOUNCE,
+	PANEL_SOCKET,
+	PANEL_SIGNAL,
+	PANEL_NFDS
+};
+
+struct menu_item {
+	char label[LCD_LINE_LEN + 1];
+	char *cmd;
+};
+
+struct panel {
+	struct hd44780 lcd;
+	struct keypad kp;
+	int fd[PANEL_NFDS];
+	struct rt_period period;	/* Scan timer jitter */
+
+	uint8_t raw[KEYPAD_KEYS];	/* Latest scan */
+	uint8_t down[KEYPAD_KEYS];	/* Debounced and reported */
+
+	/* What the application last asked to show */
+	char app[LCD_MAX_ROWS][ROW_TEXT_MAX];
+	size_t app_len[LCD_MAX_ROWS];
+
+	struct menu_item menu[MENU_MAX];
+	int nmenu;
+	int in_menu;
+	int sel;
+	int top;
+
+	unsigned long wakeups;
+	unsigned long scans;
+	unsigned long keys;
+	unsigned long updates;
+};
+
+static void usage(char **argv)
+{
+	fprintf(stderr,
+	  "Usage: %s [OPTION] ...\n"
+	  "Drive the TS-7250-V3 keypad and LCD from a single daemon\n"
+	  "\n"
+	  "  -s, --socket <path>    Display socket, default %s\n"
+	  "  -m, --menu <file>      Menu opened with 2ND, one \"label|command\"\n"
+	  "                         per line\n"
+	  "  -i, --interval <ms>    Keypad scan interval, default %d\n"
+	  "  -v, --verbose          Report wakeup and event counts, and scan\n"
+	  "                         jitter, on exit\n"
+	  RT_USAGE
+	  "  --stats                Report bus access counts and timing at exit\n"
+	  "  -h, --help             This message\n"
+	  "\n"
+	  "Key presses are printed to stdout.  Display updates are sent with\n"
+	  "lcdmesg, which hands them to this daemon while it runs.\n"
+	  "\n"
+	  "Environment: LCD_CONTRAST (0-15), LCD_GEOMETRY, LCD_BUSY_POLL,\n"
+	  "LCDMESG_SOCKET, TS_STATS.\n"
+	  "\n",
+	  argv[0], LCDSOCK_PATH, SCAN_MS
+	);
+}
+
+static int menu_load(struct panel *p, const char *path)
+{
+	char line[512], *bar, *nl;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		nl = strchr(line, '\n');
+		if (nl)
+			*nl = '\0';
+		if (line[0] == '#' || line[0] == '\0')
+			continue;
+
+		bar = strchr(line, '|');
+		if (!bar) {
+			fprintf(stderr, "%s: \"%s\" needs label|command\n",
+			  path, line);
+			fclose(f);
+			return -1;
+		}
+		if (p->nmenu == MENU_MAX) {
+			fprintf(stderr, "%s: at most %d entries\n", path,
+			  MENU_MAX);
+			fclose(f);
+			return -1;
+		}
+
+		*bar = '\0';
+		snprintf(p->menu[p->nmenu].label, sizeof(p->menu[0].label),
+		  "%.*s", LCD_LINE_LEN, line);
+		p->menu[p->nmenu].cmd = strdup(bar + 1);
+		p->nmenu++;
+	}
+	fclose(f);
+
+	return 0;
+}
+
+static void menu_draw(struct panel *p)
+{
+	char text[LCD_LINE_LEN + 2];
+	int row, rows = p->lcd.geo->rows, idx, len;
+
+	if (p->sel < p->top)
+		p->top = p->sel;
+	if (p->sel >= p->top + rows)
+		p->top = p->sel - rows + 1;
+
+	for (row = 0; row < rows; row++) {
+		idx = p->top + row;
+		len = 0;
+		if (idx < p->nmenu)
+			len = snprintf(text, sizeof(text), "%c%s",
+			  idx == p->sel ? '>' : ' ', p->menu[idx].label);
+		lcd_update_row(&p->lcd, row, text, len);
+	}
+}
+
+static void app_draw(struct panel *p)
+{
+	int row;
+
+	for (row = 0; row < p->lcd.geo->rows; row++)
+		lcd_update_row(&p->lcd, row, p->app[row], p->app_len[row]);
+}
+
+/* Commands run detached, SIGCHLD is ignored so they are reaped for us.
+ * They start with the signal state of a normal process, not the one the
+ * event loop set up, and SCHED_FIFO is never inherited, see rt_enable(). */
+static void menu_run(const char *cmd)
+{
+	sigset_t empty;
+	pid_t pid = fork();
+
+	if (pid == -1) {
+		perror("fork");
+	} else if (pid == 0) {
+		signal(SIGCHLD, SIG_DFL);
+		signal(SIGPIPE, SIG_DFL);
+		sigemptyset(&empty);
+		sigprocmask(SIG_SETMASK, &empty, NULL);
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+}
+
+static void key_event(struct panel *p, int key)
+{
+	const char *label = key_label[key];
+
+	p->keys++;
+
+	if (!p->in_menu) {
+		if (p->nmenu && !strcmp(label, "2ND")) {
+			p->in_menu = 1;
+			p->sel = 0;
+			p->top = 0;
+			menu_draw(p);
+			return;
+		}
+		printf("%s\n", label);
+		fflush(stdout);
+		return;
+	}
+
+	if (!strcmp(label, "UP")) {
+		if (p->sel > 0)
+			p->sel--;
+	} else if (!strcmp(label, "DOWN")) {
+		if (p->sel < p->nmenu - 1)
+			p->sel++;
+	} else if (!strcmp(label, "ENTER")) {
+		menu_run(p->menu[p->sel].cmd);
+		p->in_menu = 0;
+	} else if (!strcmp(label, "CLEAR") || !strcmp(label, "2ND")) {
+		p->in_menu = 0;
+	}
+
+	if (p->in_menu)
+		menu_draw(p);
+	else
+		app_draw(p);
+}
+
+static void timer_set(int fd, int ms, int periodic)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = ms / 1000;
+	its.it_value.tv_nsec = (ms % 1000) * 1000000;
+	if (periodic)
+		its.it_interval = its.it_value;
+	timerfd_settime(fd, 0, &its, NULL);
+}
+
+static void on_scan(struct panel *p)
+{
+	uint8_t keys[KEYPAD_KEYS];
+
+	rt_period_tick(&p->period);
+	scan_keypad(&p->kp, keys);
+	p->scans++;
+
+	/* Any change restarts the debounce period */
+	if (memcmp(keys, p->raw, KEYPAD_KEYS)) {
+		memcpy(p->raw, keys, KEYPAD_KEYS);
+		timer_set(p->fd[PANEL_DEBOUNCE], DEBOUNCE_MS, 0);
+	}
+}
+
+/* The raw scan has not changed for the debounce period */
+static void on_debounce(struct panel *p)
+{
+	int i;
+
+	for (i = 0; i < KEYPAD_KEYS; i++) {
+		if (p->raw[i] && !p->down[i])
+			key_event(p, i);
+		p->down[i] = p->raw[i];
+	}
+}
+
+static void on_socket(struct panel *p)
+{
+	char msg[LCDSOCK_MSG_MAX];
+	const char *m, *text;
+	ssize_t len;
+	size_t tlen;
+	int row;
+
+	while ((len = recv(p->fd[PANEL_SOCKET], msg, sizeof(msg),
+	  MSG_DONTWAIT)) >= 0) {
+		p->updates++;
+		m = msg;
+		while (lcdsock_next(&m, msg + len, &row, &text, &tlen)) {
+			if (row < 0 || row >= p->lcd.geo->rows)
+				continue;
+			if (tlen > ROW_TEXT_MAX)
+				tlen = ROW_TEXT_MAX;
+			memcpy(p->app[row], text, tlen);
+			p->app_len[row] = tlen;
+			if (!p->in_menu)
+				lcd_update_row(&p->lcd, row, text, tlen);
+		}
+	}
+}
+
+static int run_panel(struct panel *p)
+{
+	struct epoll_event ev, events[PANEL_NFDS];
+	struct signalfd_siginfo si;
+	uint64_t expirations;
+	int ep, i, n, quit = 0;
+
+	ep = epoll_create1(EPOLL_CLOEXEC);
+	if (ep == -1) {
+		perror("epoll_create1");
+		return 1;
+	}
+	for (i = 0; i < PANEL_NFDS; i++) {
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		if (epoll_ctl(ep, EPOLL_CTL_ADD, p->fd[i], &ev)) {
+			perror("epoll_ctl");
+			return 1;
+		}
+	}
+
+	while (!quit) {
+		n = epoll_wait(ep, events, PANEL_NFDS, -1);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			return 1;
+		}
+		p->wakeups++;
+		stats_inc(STATS_SYSCALLS);
+
+		for (i = 0; i < n; i++) {
+			switch (events[i].data.u32) {
+			  case PANEL_SCAN:
+				if (read(p->fd[PANEL_SCAN], &expirations,
+				  sizeof(expirations)) == sizeof(expirations))
+					on_scan(p);
+				break;
+			  case PANEL_DEBOUNCE:
+				if (read(p->fd[PANEL_DEBOUNCE], &expirations,
+				  sizeof(expirations)) == sizeof(expirations))
+					on_debounce(p);
+				break;
+			  case PANEL_SOCKET:
+				on_socket(p);
+				break;
+			  case PANEL_SIGNAL:
+				if (read(p->fd[PANEL_SIGNAL], &si, sizeof(si)) ==
+				  sizeof(si))
+					quit = 1;
+				break;
+			}
+		}
+	}
+
+	close(ep);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static struct panel p;
+	const struct lcd_geometry *geo;
+	sigset_t mask;
+	int c, ret, scan_ms = SCAN_MS, opt_verbose = 0;
+	int contrast_value = 12, opt_prio = 0, opt_cpu = -1;
+	const char *sockpath = lcdsock_path();
+	char *contrast = getenv("LCD_CONTRAST");
+	char *geometry = getenv("LCD_GEOMETRY");
+	char *busy_poll = getenv("LCD_BUSY_POLL");
+	char *opt_menu = NULL;
+
+	static struct option long_options[] = {
+	  { "socket", required_argument, NULL, 's' },
+	  { "menu", required_argument, NULL, 'm' },
+	  { "interval", required_argument, NULL, 'i' },
+	  { "verbose", no_argument, NULL, 'v' },
+	  RT_LONG_OPTIONS,
+	  { "help", no_argument, NULL, 'h' },
+	  { NULL, no_argument, NULL, 0 }
+	};
+
+	stats_init(&argc, argv);
+
+	while((c = getopt_long(argc, argv, "s:m:i:vh", long_options, NULL)) != -1) {
+		switch (c) {
+		  case 's':
+			sockpath = optarg;
+			break;
+		  case 'm':
+			opt_menu = optarg;
+			break;
+		  case 'i':
+			scan_ms = atoi(optarg);
+			if (scan_ms < 1 || scan_ms > DEBOUNCE_MS) {
+				fprintf(stderr, "Scan interval must be 1-%d ms\n",
+				  DEBOUNCE_MS);
+				return 1;
+			}
+			break;
+		  case 'v':
+			opt_verbose = 1;
+			break;
+		  case RT_OPT_PRIO:
+		  case RT_OPT_CPU:
+			if (rt_parse(c, optarg, &opt_prio, &opt_cpu))
+				return 1;
+			break;
+		  case 'h':
+		  default:
+			usage(argv);
+			return 1;
+		}
+	}
+
+	if(get_model() != 0x7250) {
+		fprintf(stderr, "This is only supported on the TS-7250-V3\n");
+		return 1;
+	}
+
+	if (contrast) {
+		contrast_value = atoi(contrast);
+		if (contrast_value < 0 || contrast_value > 0xf) {
+			fprintf(stderr, "LCD Contrast must be 0-15\n");
+			return 1;
+		}
+	}
+
+	geo = lcd_geometry_lookup(geometry);
+	if (!geo) {
+		fprintf(stderr, "Unknown LCD_GEOMETRY \"%s\", supported:",
+		  geometry);
+		lcd_geometry_list(stderr, 0);
+		return 1;
+	}
+
+	if (opt_menu && menu_load(&p, opt_menu))
+		return 1;
+
+	/* Signals are taken from the loop, commands are not waited for */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	signal(SIGCHLD, SIG_IGN);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (rt_enable(opt_prio, opt_cpu))
+		return 1;
+
+	lcd_init(&p.lcd, geo);
+	lcd_contrast(contrast_value);
+	if (busy_poll && atoi(busy_poll))
+		lcd_enable_busy_poll(&p.lcd);
+	keypad_init(&p.kp);
+
+	p.fd[PANEL_SCAN] = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	p.fd[PANEL_DEBOUNCE] = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	p.fd[PANEL_SIGNAL] = signalfd(-1, &mask, SFD_CLOEXEC);
+	if (p.fd[PANEL_SCAN] == -1 || p.fd[PANEL_DEBOUNCE] == -1 ||
+	  p.fd[PANEL_SIGNAL] == -1) {
+		perror("frontpanel");
+		return 1;
+	}
+
+	/* Listen only once the LCD is ready, as lcdmesg -d does */
+	p.fd[PANEL_SOCKET] = lcdsock_listen(sockpath);
+	if (p.fd[PANEL_SOCKET] == -1) {
+		perror(sockpath);
+		return 1;
+	}
+
+	timer_set(p.fd[PANEL_SCAN], scan_ms, 1);
+	rt_period_init(&p.period, scan_ms * 1000000ULL);
+	ret = run_panel(&p);
+
+	close(p.fd[PANEL_SOCKET]);
+	unlink(sockpath);
+
+	if (opt_verbose) {
+		fprintf(stderr, "wakeups=%lu scans=%lu keys=%lu updates=%lu\n",
+		  p.wakeups, p.scans, p.keys, p.updates);
+		rt_period_report(&p.period, stderr);
+	}
+
+	return ret;
+}
@@ -0,0 +1,263 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* A stand-in for the parts of libgpiod v1 used by the LCD and keypad code,
+ * so they can be run on a host without GPIO hardware.
+ *
+ * Each chip has plain output latches.  Two of them also simulate what is
+ * wired to them on the TS-7250-V3:
+ *  chip 2, an HD44780 controller that latches writes on the falling edge
+ *    of EN and answers status reads with its address counter.  It is never
+ *    busy.
+ *  chip 5, a 4x4 keypad matrix.  Keys set in gpiod_mock_keys pull their
+ *    column low while their row is driven low.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gpiod.h>
+#include "gpiod_mock.h"
+
+#define MOCK_CHIPS	8
+#define MOCK_LINES	32
+
+/* LCD header lines on chip 2, D0 to D7 */
+static const unsigned int lcd_data[8] = { 10, 9, 12, 11, 16, 15, 18, 17 };
+#define LCD_EN	20
+#define LCD_RS	21
+#define LCD_WR	19
+
+struct gpiod_line {
+	struct gpiod_chip *chip;
+	unsigned int offset;
+	int value;
+	int output;
+};
+
+struct gpiod_chip {
+	unsigned int num;
+	struct gpiod_line lines[MOCK_LINES];
+};
+
+static struct gpiod_chip chips[MOCK_CHIPS];
+
+uint16_t gpiod_mock_keys;
+uint8_t gpiod_mock_ddram[0x80];
+unsigned long gpiod_mock_lcd_writes;
+static uint8_t lcd_ac;
+
+static uint8_t lcd_bus(struct gpiod_chip *chip)
+{
+	uint8_t val = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		if (chip->lines[lcd_data[i]].value)
+			val |= 1 << i;
+
+	return val;
+}
+
+static void lcd_strobe(struct gpiod_chip *chip)
+{
+	uint8_t val = lcd_bus(chip);
+
+	if (chip->lines[LCD_WR].value)
+		return;
+
+	gpiod_mock_lcd_writes++;
+	if (chip->lines[LCD_RS].value) {
+		gpiod_mock_ddram[lcd_ac] = val;
+		/* 2-line mode, the counter skips the gap between lines */
+		if (lcd_ac == 0x27)
+			lcd_ac = 0x40;
+		else if (lcd_ac == 0x67)
+			lcd_ac = 0x00;
+		else
+			lcd_ac = (lcd_ac + 1) & 0x7f;
+	} else if (val & 0x80) {
+		lcd_ac = val & 0x7f;
+	} else if (val == 0x01) {
+		memset(gpiod_mock_ddram, ' ', sizeof(gpiod_mock_ddram));
+		lcd_ac = 0;
+	} else if (val == 0x02 || val == 0x03) {
+		lcd_ac = 0;
+	}
+}
+
+/* Value seen on an input, or the latch for an output */
+static int line_input(struct gpiod_line *line)
+{
+	struct gpiod_chip *chip = line->chip;
+	int i, row, col;
+
+	if (chip->num == 2 && chip->lines[LCD_WR].value &&
+	  chip->lines[LCD_EN].value) {
+		/* Status read, BF is always clear */
+		for (i = 0; i < 8; i++)
+			if (lcd_data[i] == line->offset)
+				return (lcd_ac >> i) & 1;
+	}
+
+	if (chip->num == 5 && line->offset >= 6 && line->offset <= 9) {
+		col = line->offset - 6;
+		for (row = 0; row < 4; row++)
+			if (!chip->lines[row + 1].value &&
+			  (gpiod_mock_keys & (1 << (row * 4 + col))))
+				return 0;
+		return 1;
+	}
+
+	return line->value;
+}
+
+static int line_output(struct gpiod_line *line, int value)
+{
+	int old = line->value;
+
+	line->value = !!value;
+	if (line->chip->num == 2 && line->offset == LCD_EN && old &&
+	  !line->value)
+		lcd_strobe(line->chip);
+
+	return 0;
+}
+
+struct gpiod_chip *gpiod_chip_open_by_number(unsigned int num)
+{
+	struct gpiod_chip *chip;
+	int i;
+
+	if (num >= MOCK_CHIPS) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	chip = &chips[num];
+	chip->num = num;
+	for (i = 0; i < MOCK_LINES; i++) {
+		chip->lines[i].chip = chip;
+		chip->lines[i].offset = i;
+	}
+
+	return chip;
+}
+
+void gpiod_chip_close(struct gpiod_chip *chip)
+{
+}
+
+struct gpiod_line *gpiod_chip_get_line(struct gpiod_chip *chip,
+  unsigned int offset)
+{
+	if (offset >= MOCK_LINES) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return &chip->lines[offset];
+}
+
+int gpiod_chip_get_lines(struct gpiod_chip *chip, unsigned int *offsets,
+  unsigned int num_offsets, struct gpiod_line_bulk *bulk)
+{
+	struct gpiod_line *line;
+	unsigned int i;
+
+	for (i = 0; i < num_offsets; i++) {
+		line = gpiod_chip_get_line(chip, offsets[i]);
+		if (!line)
+			return -1;
+		gpiod_line_bulk_add(bulk, line);
+	}
+
+	return 0;
+}
+
+int gpiod_line_request_output(struct gpiod_line *line, const char *consumer,
+  int default_val)
+{
+	line->output = 1;
+	return line_output(line, default_val);
+}
+
+int gpiod_line_request_input(struct gpiod_line *line, const char *consumer)
+{
+	line->output = 0;
+	return 0;
+}
+
+int gpiod_line_request_bulk_output(struct gpiod_line_bulk *bulk,
+  const char *consumer, const int *default_vals)
+{
+	unsigned int i;
+
+	for (i = 0; i < bulk->num_lines; i++)
+		gpiod_line_request_output(bulk->lines[i], consumer,
+		  default_vals ? default_vals[i] : 0);
+
+	return 0;
+}
+
+int gpiod_line_request_bulk_input(struct gpiod_line_bulk *bulk,
+  const char *consumer)
+{
+	unsigned int i;
+
+	for (i = 0; i < bulk->num_lines; i++)
+		bulk->lines[i]->output = 0;
+
+	return 0;
+}
+
+void gpiod_line_release(struct gpiod_line *line)
+{
+}
+
+void gpiod_line_release_bulk(struct gpiod_line_bulk *bulk)
+{
+}
+
+int gpiod_line_get_value(struct gpiod_line *line)
+{
+	return line->output ? line->value : line_input(line);
+}
+
+int gpiod_line_set_value(struct gpiod_line *line, int value)
+{
+	return line_output(line, value);
+}
+
+int gpiod_line_get_value_bulk(struct gpiod_line_bulk *bulk, int *values)
+{
+	unsigned int i;
+
+	for (i = 0; i < bulk->num_lines; i++)
+		values[i] = gpiod_line_get_value(bulk->lines[i]);
+
+	return 0;
+}
+
+int gpiod_line_set_value_bulk(struct gpiod_line_bulk *bulk,
+  const int *values)
+{
+	unsigned int i;
+
+	for (i = 0; i < bulk->num_lines; i++)
+		line_output(bulk->lines[i], values[i]);
+
+	return 0;
+}
+
+int gpiod_line_set_direction_input_bulk(struct gpiod_line_bulk *bulk)
+{
+	return gpiod_line_request_bulk_input(bulk, NULL);
+}
+
+int gpiod_line_set_direction_output_bulk(struct gpiod_line_bulk *bulk,
+  const int *values)
+{
+	return gpiod_line_request_bulk_output(bulk, NULL, values);
+}
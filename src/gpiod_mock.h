@@ -0,0 +1,16 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __GPIOD_MOCK_H__
+#define __GPIOD_MOCK_H__
+
+#include <stdint.h>
+
+/* Keys held down on the simulated keypad, bit n is key n */
+extern uint16_t gpiod_mock_keys;
+
+/* Contents of the simulated LCD and the number of writes it has seen */
+extern uint8_t gpiod_mock_ddram[0x80];
+extern unsigned long gpiod_mock_lcd_writes;
+
+#endif //__GPIOD_MOCK_H__
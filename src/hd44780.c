@@ -0,0 +1,677 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* HD44780 character LCD driven by bit-banging GPIO.
+ *
+ * A shadow copy of DDRAM is kept so that row updates only send the
+ * characters that actually changed.  Every bus write, data or command,
+ * costs at least the 37us execution time of the controller, so the update
+ * path counts writes and picks whichever of a Set-DDRAM-Address jump or
+ * rewriting unchanged characters is cheaper.
+ *
+ * The 8 CGRAM slots are managed as a cache of custom glyphs keyed by their
+ * bitmap.  Text can carry "\g" followed by 16 hex digits, the 8 rows of a
+ * 5x8 glyph top to bottom.  A glyph is only uploaded, at a cost of 9 bus
+ * writes, when it is not already resident.  Glyphs are displayed with
+ * character codes 8-15, which alias CGRAM 0-7, so text never contains NUL.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <gpiod.h>
+#include <assert.h>
+#include <time.h>
+#include "helpers.h"
+#include "delay.h"
+#include "fpga.h"
+#include "fpga_lock.h"
+#include "hd44780.h"
+#include "stats.h"
+
+#define CONSUMER "lcdmesg"
+
+/* Number of bus writes a Set-DDRAM-Address command costs.  A gap of
+ * unchanged characters at most this long is rewritten instead of jumped. */
+#define LCD_JUMP_COST	1
+
+/* Longest to wait for BF to clear before assuming read-back is broken.  The
+ * slowest command is 1.52ms at the nominal 270kHz oscillator. */
+#define LCD_BUSY_TIMEOUT_US	10000
+
+/* The first entry is the default.  Its second row address matches what
+ * lcdmesg has always used on embeddedTS panels.  Standard 2-line modules
+ * start the second line at 0x40, and 4-line modules continue rows 0 and 1
+ * in the same DDRAM lines at rows 2 and 3.
+ */
+static const struct lcd_geometry lcd_geometries[] = {
+	{ "default", 40, 2, { 0x00, 0x28 } },
+	{ "8x2", 8, 2, { 0x00, 0x40 } },
+	{ "16x1", 16, 1, { 0x00 } },
+	{ "16x2", 16, 2, { 0x00, 0x40 } },
+	{ "20x2", 20, 2, { 0x00, 0x40 } },
+	{ "24x2", 24, 2, { 0x00, 0x40 } },
+	{ "40x2", 40, 2, { 0x00, 0x40 } },
+	{ "16x4", 16, 4, { 0x00, 0x40, 0x10, 0x50 } },
+	{ "20x4", 20, 4, { 0x00, 0x40, 0x14, 0x54 } },
+};
+
+const struct lcd_geometry *lcd_geometry_lookup(const char *name)
+{
+	int i;
+
+	if (name == NULL)
+		return &lcd_geometries[0];
+
+	for (i = 0; i < sizeof(lcd_geometries)/sizeof(lcd_geometries[0]); i++)
+		if (!strcmp(lcd_geometries[i].name, name))
+			return &lcd_geometries[i];
+
+	return NULL;
+}
+
+void lcd_geometry_list(FILE *stream, int marquee)
+{
+	int i;
+
+	for (i = 0; i < sizeof(lcd_geometries)/sizeof(lcd_geometries[0]); i++)
+		if (!marquee || lcd_marquee_geometry(&lcd_geometries[i]))
+			fprintf(stream, " %s", lcd_geometries[i].name);
+	fprintf(stream, "\n");
+}
+
+void set_8bit_array(int *val, uint8_t data)
+{
+	val[0] = data & (1 << 0);
+	val[1] = data & (1 << 1);
+	val[2] = data & (1 << 2);
+	val[3] = data & (1 << 3);
+	val[4] = data & (1 << 4);
+	val[5] = data & (1 << 5);
+	val[6] = data & (1 << 6);
+	val[7] = data & (1 << 7);
+}
+
+uint8_t get_8bit_array(int *val)
+{
+	uint8_t ret;
+	ret = (val[0] << 0);
+	ret |= (val[1] << 1);
+	ret |= (val[2] << 2);
+	ret |= (val[3] << 3);
+	ret |= (val[4] << 4);
+	ret |= (val[5] << 5);
+	ret |= (val[6] << 6);
+	ret |= (val[7] << 7);
+	return ret;
+}
+
+/* Read the busy flag and address counter.  The data lines must already be
+ * inputs.  Returns the status byte, or -1 if the lines cannot be read.
+ */
+static int lcd_read_status(struct hd44780 *lcd)
+{
+	struct stats_mark m;
+	int val[8];
+	int ret;
+
+	stats_begin(&m);
+	gpiod_line_set_value(lcd->rs, 0);
+	gpiod_line_set_value(lcd->wr, 1);
+	ndelay(60); /* tAS */
+	gpiod_line_set_value(lcd->en, 1);
+	ndelay(230); /* tDDR, data is valid before PWEH ends */
+	ret = gpiod_line_get_value_bulk(&lcd->data, val);
+	gpiod_line_set_value(lcd->en, 0);
+	ndelay(210); /* tH/tAH + tcycE */
+	stats_end(STATS_LCD_STATUS, &m);
+	stats_add(STATS_GPIO_WRITE, 4);
+	stats_inc(STATS_GPIO_READ);
+	stats_add(STATS_SYSCALLS, 5);
+
+	if (ret)
+		return -1;
+	return get_8bit_array(val);
+}
+
+static int lcd_data_input(struct hd44780 *lcd)
+{
+	if (!lcd->data_input) {
+		stats_inc(STATS_GPIO_WRITE);
+		stats_inc(STATS_SYSCALLS);
+		if (gpiod_line_set_direction_input_bulk(&lcd->data))
+			return -1;
+		lcd->data_input = 1;
+	}
+
+	return 0;
+}
+
+/* Give up on read-back and use the worst case execution times from here on.
+ * The data lines are left as inputs, the next write turns them around. */
+static void lcd_busy_poll_failed(struct hd44780 *lcd, const char *why)
+{
+	fprintf(stderr, "LCD busy flag %s, falling back to timed delays\n",
+	  why);
+	lcd->busy_poll = 0;
+}
+
+/* Wait for the controller to finish a command that takes at most exec_us
+ * microseconds.  With busy polling this returns as soon as BF clears.
+ */
+static void lcd_wait(struct hd44780 *lcd, unsigned int exec_us)
+{
+	struct timespec start, now;
+	int status;
+
+	if (lcd->busy_poll) {
+		if (lcd_data_input(lcd)) {
+			lcd_busy_poll_failed(lcd, "unreadable");
+			udelay(exec_us);
+			return;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		while (1) {
+			status = lcd_read_status(lcd);
+			if (status < 0) {
+				lcd_busy_poll_failed(lcd, "unreadable");
+				break;
+			}
+			if (!(status & 0x80))
+				return;
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if ((now.tv_sec - start.tv_sec) * 1000000 +
+			  (now.tv_nsec - start.tv_nsec) / 1000 >
+			  LCD_BUSY_TIMEOUT_US) {
+				lcd_busy_poll_failed(lcd, "stuck busy");
+				break;
+			}
+		}
+	}
+
+	udelay(exec_us);
+}
+
+/* https://www.sparkfun.com/datasheets/LCD/HD44780.pdf
+ * Sheet 58 */
+static void lcd_xfer(struct hd44780 *lcd, uint8_t rs, uint8_t data,
+  unsigned int exec_us)
+{
+	struct stats_mark m;
+	int val[8];
+	set_8bit_array(val, data);
+
+	stats_begin(&m);
+	gpiod_line_set_value(lcd->rs, rs);
+	gpiod_line_set_value(lcd->wr, 0);
+	if (lcd->data_input) {
+		/* Turn the bus around and drive the new value in one call */
+		gpiod_line_set_direction_output_bulk(&lcd->data, val);
+		lcd->data_input = 0;
+	} else {
+		gpiod_line_set_value_bulk(&lcd->data, val);
+	}
+	ndelay(60); /* tAS */
+	gpiod_line_set_value(lcd->en, 1);
+	ndelay(230); /* PWEH */
+	gpiod_line_set_value(lcd->en, 0);
+	ndelay(210); /* tH/tAH + tcycE */
+	stats_end(STATS_LCD_BUS, &m);
+	stats_add(STATS_GPIO_WRITE, 5);
+	stats_add(STATS_SYSCALLS, 5);
+
+	lcd_wait(lcd, exec_us);
+}
+
+void lcd_write(struct hd44780 *lcd, uint8_t rs, uint8_t data)
+{
+	struct stats_mark m;
+
+	/* All commands other than Clear Display and Return Home, and all
+	 * data writes, take 37us */
+	stats_begin(&m);
+	lcd_xfer(lcd, rs, data, 37);
+	stats_end(STATS_LCD_WRITE, &m);
+}
+
+/* Set a contrast (duty cycle) from 0 (off) to 15 (max).
+ * This may need to change depending on the LCD used or the altitude */
+void lcd_contrast(uint8_t duty)
+{
+	fpga_rmw32(0x1c, 0xf, duty);
+}
+
+/* The address counter after a write at ac.  Init selects 2-line mode, in
+ * which each line holds 40 characters and the counter skips the gap from
+ * the end of one line to the start of the other. */
+static int lcd_ac_next(int ac)
+{
+	if (ac == LCD_LINE_LEN - 1)
+		return 0x40;
+	if (ac == 0x40 + LCD_LINE_LEN - 1)
+		return 0x00;
+	return (ac + 1) & (LCD_DDRAM_SIZE - 1);
+}
+
+/* Write characters at the current address counter.  The shadow copy is
+ * only updated while the address counter is known. */
+void lcd_writechars(struct hd44780 *lcd, char *dat)
+{
+	while(*dat) {
+		if (lcd->ac >= 0) {
+			lcd->ddram[lcd->ac] = *dat;
+			lcd->ac = lcd_ac_next(lcd->ac);
+		}
+		lcd_write(lcd, 1, *dat++);
+	}
+}
+
+void lcd_returnhome(struct hd44780 *lcd)
+{
+	/* Return home must wait 1.52ms, but all other commands are 37us */
+	lcd_xfer(lcd, 0, 0x2, 1520);
+	lcd->ac = 0;
+}
+
+void lcd_clear(struct hd44780 *lcd)
+{
+	/* Clear Display fills DDRAM with spaces and homes the cursor, it has
+	 * the same execution time as Return Home.
+	 */
+	lcd_xfer(lcd, 0, 0x1, 1520);
+	memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+	lcd->ac = 0;
+}
+
+void lcd_set_ddram(struct hd44780 *lcd, uint8_t addr)
+{
+	addr &= (LCD_DDRAM_SIZE - 1);
+	lcd_write(lcd, 0, 0x80 | addr);
+	lcd->ac = addr;
+}
+
+static int hexval(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* Parse the 16 hex digits of a glyph escape into 8 row bitmaps */
+static int parse_glyph(const char *hex, uint8_t *bitmap)
+{
+	int i, hi, lo;
+
+	for (i = 0; i < 8; i++) {
+		hi = hexval(hex[i * 2]);
+		lo = hexval(hex[i * 2 + 1]);
+		if (hi < 0 || lo < 0)
+			return -1;
+		bitmap[i] = ((hi << 4) | lo) & 0x1f;
+	}
+
+	return 0;
+}
+
+/* A slot is in use if its character code is anywhere on screen, in which
+ * case replacing the bitmap would change what is displayed. */
+static int glyph_on_screen(struct hd44780 *lcd, int slot)
+{
+	const struct lcd_geometry *geo = lcd->geo;
+	uint8_t *cur;
+	int row, i;
+
+	for (row = 0; row < geo->rows; row++) {
+		cur = &lcd->ddram[geo->row_addr[row]];
+		for (i = 0; i < geo->cols; i++)
+			if (cur[i] < 0x10 && (cur[i] & 0x7) == slot)
+				return 1;
+	}
+
+	return 0;
+}
+
+/* Find or load a glyph.  Slots used since the clock value pinned are never
+ * evicted, so every glyph resolved for one row stays resident until it has
+ * been written.
+ *
+ * Returns the character code, or -1 if every slot is pinned.
+ */
+static int lcd_glyph_get(struct hd44780 *lcd, const uint8_t *bitmap,
+  uint32_t pinned, int *writes)
+{
+	struct lcd_glyph *g;
+	int i, slot = -1, visible = -1, any = -1;
+
+	for (i = 0; i < LCD_GLYPH_SLOTS; i++) {
+		g = &lcd->glyphs[i];
+		if (g->valid && !memcmp(g->bitmap, bitmap, 8)) {
+			g->last_used = ++lcd->glyph_clock;
+			lcd->glyph_hits++;
+			return LCD_GLYPH_CODE(i);
+		}
+	}
+	lcd->glyph_misses++;
+
+	/* Prefer an empty slot, then the least recently used slot that is
+	 * not on screen, then the least recently used one overall. */
+	for (i = 0; i < LCD_GLYPH_SLOTS; i++) {
+		g = &lcd->glyphs[i];
+		if (!g->valid) {
+			slot = i;
+			break;
+		}
+		if (g->last_used > pinned)
+			continue;
+		if (any < 0 || g->last_used < lcd->glyphs[any].last_used)
+			any = i;
+		if (!glyph_on_screen(lcd, i) && (visible < 0 ||
+		  g->last_used < lcd->glyphs[visible].last_used))
+			visible = i;
+	}
+	if (slot < 0) {
+		slot = (visible >= 0) ? visible : any;
+		if (slot < 0)
+			return -1;
+		lcd->glyph_evictions++;
+	}
+
+	/* Set CGRAM address, the address counter no longer points at DDRAM */
+	g = &lcd->glyphs[slot];
+	lcd_write(lcd, 0, 0x40 | (slot << 3));
+	for (i = 0; i < 8; i++)
+		lcd_write(lcd, 1, bitmap[i]);
+	lcd->ac = -1;
+	*writes += 9;
+
+	memcpy(g->bitmap, bitmap, 8);
+	g->valid = 1;
+	g->last_used = ++lcd->glyph_clock;
+
+	return LCD_GLYPH_CODE(slot);
+}
+
+int lcd_glyph(struct hd44780 *lcd, const uint8_t *bitmap)
+{
+	int writes = 0;
+
+	return lcd_glyph_get(lcd, bitmap, lcd->glyph_clock, &writes);
+}
+
+/* Copy at most max display characters from text, replacing each glyph
+ * escape with the character code of a resident CGRAM slot.
+ *
+ * Returns the number of characters stored in out.
+ */
+static size_t lcd_expand(struct hd44780 *lcd, const char *text, size_t len,
+  uint8_t *out, size_t max, int *writes)
+{
+	uint32_t pinned = lcd->glyph_clock;
+	uint8_t bitmap[8];
+	size_t n = 0;
+	int code;
+
+	while (len && n < max) {
+		if (len >= 18 && text[0] == '\\' && text[1] == 'g' &&
+		  !parse_glyph(text + 2, bitmap)) {
+			code = lcd_glyph_get(lcd, bitmap, pinned, writes);
+			out[n++] = (code < 0) ? '?' : code;
+			text += 18;
+			len -= 18;
+			continue;
+		}
+		out[n++] = *text++;
+		len--;
+	}
+
+	return n;
+}
+
+/* Bring n bytes of DDRAM starting at addr up to date with want, sending
+ * only what differs from the shadow copy.
+ *
+ * Returns the number of bus writes issued.
+ */
+static int lcd_store(struct hd44780 *lcd, uint8_t addr, const uint8_t *want,
+  int n)
+{
+	uint8_t *cur = &lcd->ddram[addr];
+	int i, start, end, writes = 0;
+
+	i = 0;
+	while (i < n) {
+		if (cur[i] == want[i]) {
+			i++;
+			continue;
+		}
+
+		/* Extend the run over any following gap of unchanged characters
+		 * that is cheaper to rewrite than to jump over. */
+		start = i;
+		end = i + 1;
+		for (i = end; i < n; i++) {
+			if (cur[i] != want[i])
+				end = i + 1;
+			else if (i - end >= LCD_JUMP_COST)
+				break;
+		}
+
+		if (lcd->ac != addr + start) {
+			lcd_set_ddram(lcd, addr + start);
+			writes++;
+		}
+		for (; start < end; start++) {
+			lcd_write(lcd, 1, want[start]);
+			cur[start] = want[start];
+			writes++;
+		}
+		lcd->ac = lcd_ac_next(addr + end - 1);
+		i = end;
+	}
+
+	return writes;
+}
+
+int lcd_update_row(struct hd44780 *lcd, int row, const char *text, size_t len)
+{
+	const struct lcd_geometry *geo = lcd->geo;
+	uint8_t want[LCD_DDRAM_SIZE];
+	int writes = 0;
+
+	assert(row >= 0 && row < geo->rows);
+
+	len = lcd_expand(lcd, text, len, want, geo->cols, &writes);
+	memset(want + len, ' ', geo->cols - len);
+
+	return writes + lcd_store(lcd, geo->row_addr[row], want, geo->cols);
+}
+
+/* Marquee scrolling uses the display shift, which moves every line of the
+ * display through its own 40 character DDRAM ring.  Each row must
+ * therefore start its own DDRAM line, which rules out the 4 line layouts
+ * and the default second row address.
+ */
+int lcd_marquee_geometry(const struct lcd_geometry *geo)
+{
+	int row;
+
+	for (row = 0; row < geo->rows; row++)
+		if (geo->row_addr[row] != row * 0x40)
+			return 0;
+	return 1;
+}
+
+int lcd_marquee_init(struct hd44780 *lcd, struct lcd_marquee *m, int nrows,
+  char **text)
+{
+	const struct lcd_geometry *geo = lcd->geo;
+	int row, len, writes = 0;
+
+	if (!lcd_marquee_geometry(geo))
+		return -1;
+
+	memset(m, 0, sizeof(*m));
+	m->rows = (nrows < geo->rows) ? nrows : geo->rows;
+	for (row = 0; row < m->rows; row++) {
+		len = lcd_expand(lcd, text[row], strlen(text[row]),
+		  m->text[row], LCD_MARQUEE_MAX - LCD_MARQUEE_GAP, &writes);
+		if (len + LCD_MARQUEE_GAP > m->len)
+			m->len = len + LCD_MARQUEE_GAP;
+	}
+	if (m->len < LCD_LINE_LEN)
+		m->len = LCD_LINE_LEN;
+	for (row = 0; row < m->rows; row++) {
+		len = strnlen((char *)m->text[row], LCD_MARQUEE_MAX);
+		memset(m->text[row] + len, ' ', m->len - len);
+	}
+
+	/* Return home also undoes any previous display shift */
+	lcd_returnhome(lcd);
+	writes++;
+	for (row = 0; row < m->rows; row++)
+		writes += lcd_store(lcd, row * 0x40, m->text[row],
+		  LCD_LINE_LEN);
+
+	return writes;
+}
+
+int lcd_marquee_step(struct hd44780 *lcd, struct lcd_marquee *m)
+{
+	int cols = lcd->geo->cols;
+	int row, col, next, writes = 1;
+
+	/* Text that fits the DDRAM ring is all loaded, just shift it */
+	if (m->len == LCD_LINE_LEN) {
+		lcd_write(lcd, 0, 0x18);
+		m->shift = (m->shift + 1) % LCD_LINE_LEN;
+		return writes;
+	}
+
+	/* Otherwise refill the column about to scroll into view.  While it is
+	 * still off screen to the right it can be written before the shift,
+	 * a full 40 column display has to shift first. */
+	next = (m->pos + cols) % m->len;
+	col = (m->shift + cols) % LCD_LINE_LEN;
+	if (cols == LCD_LINE_LEN)
+		lcd_write(lcd, 0, 0x18);
+	for (row = 0; row < m->rows; row++)
+		writes += lcd_store(lcd, row * 0x40 + col, &m->text[row][next],
+		  1);
+	if (cols != LCD_LINE_LEN)
+		lcd_write(lcd, 0, 0x18);
+	m->pos = (m->pos + 1) % m->len;
+	m->shift = (m->shift + 1) % LCD_LINE_LEN;
+
+	return writes;
+}
+
+void lcd_init(struct hd44780 *lcd, const struct lcd_geometry *geo)
+{
+	int ret;
+	int model;
+
+	model = get_model();
+	if(model == 0x7250){
+		unsigned int datapins[8] = {10, 9, 12, 11, 16, 15, 18, 17};
+
+		lcd->chip = gpiod_chip_open_by_number(2);
+		assert(lcd->chip);
+		gpiod_line_bulk_init(&lcd->data);
+		ret = gpiod_chip_get_lines(lcd->chip, datapins, 8, &lcd->data);
+		assert(!ret);
+		lcd->en = gpiod_chip_get_line(lcd->chip, 20);
+		assert(lcd->en);
+		lcd->rs = gpiod_chip_get_line(lcd->chip, 21);
+		assert(lcd->rs);
+		lcd->wr = gpiod_chip_get_line(lcd->chip, 19);
+		assert(lcd->wr);
+	} else {
+		fprintf(stderr, "Unsupported model 0x%X\n", model);
+		exit(1);
+	}
+
+	lcd->geo = geo ? geo : lcd_geometry_lookup(NULL);
+	lcd->ac = -1;
+	lcd->busy_poll = 0;
+	lcd->data_input = 0;
+	memset(lcd->glyphs, 0, sizeof(lcd->glyphs));
+	lcd->glyph_clock = 0;
+	lcd->glyph_hits = lcd->glyph_misses = lcd->glyph_evictions = 0;
+	delay_init();
+
+	fpga_init(0x50004000);
+
+	/* Initialize all IO as high */
+	ret = gpiod_line_request_bulk_output(&lcd->data, CONSUMER, NULL);
+	ret |= gpiod_line_request_output(lcd->en, CONSUMER, 1);
+	ret |= gpiod_line_request_output(lcd->rs, CONSUMER, 1);
+	ret |= gpiod_line_request_output(lcd->wr, CONSUMER, 1);
+	assert(!ret);
+
+	/* Recover from any potential state to 8-bit mode, and set:
+	 * Function Set
+	 * DL = 1 (8-bits)
+	 * N = 1 (2 line)
+	 * F = 0 (5x8 dots)
+	 */
+	lcd_write(lcd, 0, 0x38);
+	lcd_write(lcd, 0, 0x38);
+	lcd_write(lcd, 0, 0x38);
+
+	/*
+	 * Entry Mode Set
+	 * I/D = 1 (increment)
+	 * S = 0 (display shift off)
+	 */
+	lcd_write(lcd, 0, 0x6);
+
+	/*
+	 * Display on/off Control
+	 * D = 1 (display on)
+	 * C = 0 (cursor off)
+	 * B = 0 (cursor blink off)
+	 */
+	lcd_write(lcd, 0, 0xc);
+
+	/*
+	 * Clear Display, this also returns home
+	 */
+	lcd_clear(lcd);
+}
+
+/* Switch from worst case delays to polling the busy flag.  WR must be wired
+ * for this to work, so read-back is verified first by reading the address
+ * counter back after setting it to a known value.
+ *
+ * Returns 0 if busy polling is now in use, -1 if timed delays remain.
+ */
+int lcd_enable_busy_poll(struct hd44780 *lcd)
+{
+	int status;
+
+	/* Any address other than 0 proves the lines are actually driven */
+	lcd_set_ddram(lcd, 0x05);
+
+	if (lcd_data_input(lcd)) {
+		fprintf(stderr, "LCD data lines cannot be read, using timed "
+		  "delays\n");
+		return -1;
+	}
+
+	status = lcd_read_status(lcd);
+	if (status < 0 || (status & 0x7f) != 0x05) {
+		fprintf(stderr, "LCD read-back failed (0x%X), using timed "
+		  "delays\n", status);
+		return -1;
+	}
+
+	lcd->busy_poll = 1;
+	return 0;
+}
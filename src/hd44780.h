@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __HD44780_H__
+#define __HD44780_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <gpiod.h>
+
+/* The controller has 80 bytes of DDRAM, but addresses are 7 bits wide and
+ * the second line of a 2-line display starts at 0x40.  The shadow copy is
+ * indexed directly by DDRAM address.
+ */
+#define LCD_DDRAM_SIZE		0x80
+#define LCD_MAX_ROWS		4
+
+struct lcd_geometry {
+	const char *name;
+	uint8_t cols;
+	uint8_t rows;
+	uint8_t row_addr[LCD_MAX_ROWS];
+};
+
+/* Each line of a 2-line display is a 40 character ring for display shift */
+#define LCD_LINE_LEN		40
+#define LCD_MARQUEE_MAX		512
+#define LCD_MARQUEE_GAP		4
+
+#define LCD_GLYPH_SLOTS		8
+#define LCD_GLYPH_CODE(slot)	(0x08 + (slot))
+
+struct lcd_glyph {
+	uint8_t bitmap[8];
+	uint8_t valid;
+	uint32_t last_used;
+};
+
+struct hd44780 {
+	struct gpiod_chip *chip;
+	struct gpiod_line_bulk data;
+	struct gpiod_line *en;
+	struct gpiod_line *rs;
+	struct gpiod_line *wr;
+
+	const struct lcd_geometry *geo;
+	int busy_poll;			/* Poll BF instead of fixed delays */
+	int data_input;			/* Data lines currently inputs */
+	int ac;				/* DDRAM address counter, -1 if unknown */
+	uint8_t ddram[LCD_DDRAM_SIZE];	/* Shadow of what the display holds */
+
+	struct lcd_glyph glyphs[LCD_GLYPH_SLOTS];
+	uint32_t glyph_clock;
+	unsigned long glyph_hits;
+	unsigned long glyph_misses;
+	unsigned long glyph_evictions;
+};
+
+/* Look up a geometry by name, e.g. "20x4".  NULL returns the default
+ * geometry, an unknown name returns NULL. */
+const struct lcd_geometry *lcd_geometry_lookup(const char *name);
+
+/* Print the geometry names on one line, only those marquee can scroll if
+ * marquee is set */
+void lcd_geometry_list(FILE *stream, int marquee);
+
+void lcd_init(struct hd44780 *lcd, const struct lcd_geometry *geo);
+int lcd_enable_busy_poll(struct hd44780 *lcd);
+void lcd_write(struct hd44780 *lcd, uint8_t rs, uint8_t data);
+void lcd_contrast(uint8_t duty);
+void lcd_writechars(struct hd44780 *lcd, char *dat);
+void lcd_returnhome(struct hd44780 *lcd);
+void lcd_clear(struct hd44780 *lcd);
+void lcd_set_ddram(struct hd44780 *lcd, uint8_t addr);
+
+/* Make a 5x8 glyph resident in CGRAM, uploading it only on a cache miss.
+ * bitmap holds 8 rows, top to bottom, in the low 5 bits of each byte.
+ *
+ * Returns the character code to display it with.
+ */
+int lcd_glyph(struct hd44780 *lcd, const uint8_t *bitmap);
+
+/* Replace the contents of one row with len bytes of text, padded with
+ * spaces or truncated to the row width.  Glyph escapes ("\g" and 16 hex
+ * digits) are resolved through the CGRAM cache.  Only the characters that
+ * differ from the shadow copy are sent to the display.
+ *
+ * Returns the number of bus writes issued.
+ */
+int lcd_update_row(struct hd44780 *lcd, int row, const char *text, size_t len);
+
+struct lcd_marquee {
+	uint8_t text[LCD_MAX_ROWS][LCD_MARQUEE_MAX];
+	int rows;
+	int len;		/* Length every row is padded to */
+	int pos;		/* Position in the text of the first column */
+	int shift;		/* Current display shift */
+};
+
+/* Nonzero if every row of geo starts its own DDRAM line, as marquee
+ * scrolling needs.  The default geometry does not. */
+int lcd_marquee_geometry(const struct lcd_geometry *geo);
+
+/* Load rows of text for hardware scrolling.  Text that fits in DDRAM is
+ * written once, longer text is refilled one column per step as it scrolls
+ * into view.
+ *
+ * Returns the number of bus writes issued, or -1 if the geometry does not
+ * give every row its own DDRAM line.
+ */
+int lcd_marquee_init(struct hd44780 *lcd, struct lcd_marquee *m, int nrows,
+  char **text);
+
+/* Scroll every row one character left.  Costs a single display shift
+ * write, plus one refill per row for text longer than DDRAM.
+ *
+ * Returns the number of bus writes issued.
+ */
+int lcd_marquee_step(struct hd44780 *lcd, struct lcd_marquee *m);
+
+#endif //__HD44780_H__
@@ -0,0 +1,838 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Microbenchmarks of the hardware access paths, run against simulated
+ * backends so they work on a build host as well as on a board:
+ *  FPGA registers, a memfd in place of /dev/mem
+ *  PC/104 bus, files on a tmpfs in place of the fpgaisa sysfs nodes
+ *  LCD and keypad GPIO, the mock in gpiod_mock.c
+ *  FPGA interrupts, an eventfd raised by a second thread
+ *  The FPGA lock and telemetry, shared memory objects private to the run
+ *
+ * Each benchmark is timed in batches of operations.  One JSON object per
+ * benchmark is printed to stdout with the throughput and the median and
+ * 99th percentile time per operation over all batches.
+ *
+ * --lock-stress instead has several processes increment one register
+ * under the FPGA lock, after one of them died holding it, and fails if
+ * any increment was lost.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "eval_cmdline.h"
+#include "fpga.h"
+#include "fpga_irq.h"
+#include "fpga_lock.h"
+#include "gpiod_mock.h"
+#include "hd44780.h"
+#include "keypad_scan.h"
+#include "pc104.h"
+#include "rgb565.h"
+#include "stats.h"
+#include "telemetry.h"
+
+#define SAMPLES_DEFAULT	1000
+#define SPLASH_W	240
+#define SPLASH_H	320
+
+/* Scratch registers for the interrupt source and the lock tests */
+#define IRQ_REG		0x40
+#define LOCK_REG	0x44
+
+#define STRESS_OPS	1000000
+
+/* A typical TS-7100 command line, with the looked up token near the end */
+#define BENCH_CMDLINE "console=ttymxc0,115200 root=/dev/mmcblk0p1 rootwait " \
+  "rw init=/sbin/init loglevel=4 bootmode=0x1 cma=32M " \
+  "ts7100_fpga_rev=0x12 ts7100_straps=0x5\n"
+
+struct bench {
+	const char *name;
+	int batch;		/* Operations per timed sample */
+	int (*setup)(void);
+	void (*run)(int n);
+};
+
+static volatile uint32_t sink;
+static struct hd44780 lcd;
+static struct keypad kp;
+static uint8_t *rgb, *out;
+static struct fpga_window win;
+static uint32_t win_buf[1024];
+static char isa_dir[256];
+static struct fpga_irq irq;
+static int irq_kick;
+static char lock_name[64];
+static int flock_fd = -1;
+static char telemetry_shm_name[64];
+static struct telemetry_shm *telemetry;
+#if defined(__arm__) && !defined(__thumb__)
+static volatile uint8_t *bus_space;
+#endif
+
+/* The LCD code checks the model, pretend to be the board it supports */
+int get_model(void)
+{
+	return 0x7250;
+}
+
+static int setup_fpga(void)
+{
+	static int done;
+	int fd;
+
+	if (done)
+		return 0;
+
+	fd = memfd_create("fpga", 0);
+	if (fd == -1 || ftruncate(fd, getpagesize())) {
+		perror("memfd_create");
+		return -1;
+	}
+	fpga_init_fd(fd, 0);
+	done = 1;
+
+	return 0;
+}
+
+/* A second window on a regular file, as for FPGA buffer RAM */
+static int setup_window(void)
+{
+	char path[] = "/dev/shm/hwbench-win.XXXXXX";
+	int fd;
+
+	if (win.regs)
+		return 0;
+
+	fd = mkstemp(path);
+	if (fd == -1 || ftruncate(fd, sizeof(win_buf))) {
+		perror("mkstemp");
+		return -1;
+	}
+	close(fd);
+	if (fpga_map(&win, path, 0, 0, FPGA_MAP_WC)) {
+		unlink(path);
+		return -1;
+	}
+	unlink(path);
+
+	return 0;
+}
+
+static const char * const isa_nodes[] = {
+	"io8", "io16", "ioalt16", "mem8", "mem16", "memalt16",
+};
+
+static void cleanup_pc104(void)
+{
+	char path[sizeof(isa_dir) + 16];
+	int i;
+
+	for (i = 0; i < 6; i++) {
+		snprintf(path, sizeof(path), "%s/%s", isa_dir, isa_nodes[i]);
+		unlink(path);
+	}
+	rmdir(isa_dir);
+}
+
+static int setup_pc104(void)
+{
+	static int done;
+	char path[sizeof(isa_dir) + 16];
+	int i, fd;
+
+	if (done)
+		return 0;
+
+	/* Fall back to $TMPDIR when /dev/shm is not there */
+	strcpy(isa_dir, "/dev/shm/hwbench.XXXXXX");
+	if (!mkdtemp(isa_dir)) {
+		const char *tmp = getenv("TMPDIR");
+
+		snprintf(isa_dir, sizeof(isa_dir), "%s/hwbench.XXXXXX",
+		  tmp ? tmp : "/tmp");
+		if (!mkdtemp(isa_dir)) {
+			perror("mkdtemp");
+			return -1;
+		}
+	}
+	atexit(cleanup_pc104);
+
+	for (i = 0; i < 6; i++) {
+		snprintf(path, sizeof(path), "%s/%s", isa_dir, isa_nodes[i]);
+		fd = open(path, O_RDWR | O_CREAT, 0600);
+		if (fd == -1 || ftruncate(fd, 0x100000)) {
+			perror(path);
+			return -1;
+		}
+		close(fd);
+	}
+	pc104_init_path(isa_dir);
+	done = 1;
+
+	return 0;
+}
+
+#if defined(__arm__) && !defined(__thumb__)
+static int setup_pc104_mmap(void)
+{
+	if (setup_pc104())
+		return -1;
+	if (!bus_space)
+		bus_space = pc104_mmap_init();
+
+	return bus_space ? 0 : -1;
+}
+#endif
+
+static int setup_lcd(void)
+{
+	static int done;
+
+	if (done)
+		return 0;
+	if (setup_fpga())
+		return -1;
+
+	lcd_init(&lcd, NULL);
+	done = 1;
+
+	return 0;
+}
+
+static int setup_lcd_poll(void)
+{
+	if (setup_lcd() || lcd_enable_busy_poll(&lcd))
+		return -1;
+
+	return 0;
+}
+
+static int setup_lcd_timed(void)
+{
+	if (setup_lcd())
+		return -1;
+	lcd.busy_poll = 0;
+
+	return 0;
+}
+
+static int setup_keypad(void)
+{
+	static int done;
+
+	if (!done) {
+		keypad_init(&kp);
+		done = 1;
+	}
+	/* "5" held down */
+	gpiod_mock_keys = 1 << 5;
+
+	return 0;
+}
+
+static int setup_eval(void)
+{
+	eval_cmd_init_str(BENCH_CMDLINE);
+
+	return 0;
+}
+
+static int setup_rgb565(void)
+{
+	size_t i;
+
+	if (rgb)
+		return 0;
+
+	rgb = malloc(SPLASH_W * SPLASH_H * 3);
+	out = malloc(SPLASH_W * SPLASH_H * 2);
+	if (!rgb || !out) {
+		perror("malloc");
+		return -1;
+	}
+	for (i = 0; i < SPLASH_W * SPLASH_H * 3; i++)
+		rgb[i] = i * 7;
+
+	return 0;
+}
+
+/* Stands in for the FPGA: on each kick, set the status bit and raise the
+ * interrupt */
+static void *irq_source(void *arg)
+{
+	uint64_t v;
+
+	while (read(irq_kick, &v, sizeof(v)) == sizeof(v)) {
+		fpoke32(IRQ_REG, 1);
+		v = 1;
+		if (write(irq.fd, &v, sizeof(v)) != sizeof(v))
+			break;
+	}
+
+	return NULL;
+}
+
+static int setup_irq(void)
+{
+	pthread_t thread;
+	int fd;
+
+	if (irq_kick)
+		return 0;
+	if (setup_fpga())
+		return -1;
+
+	fd = eventfd(0, EFD_CLOEXEC);
+	irq_kick = eventfd(0, EFD_CLOEXEC);
+	if (fd == -1 || irq_kick == -1) {
+		perror("eventfd");
+		return -1;
+	}
+	fpga_irq_open_fd(&irq, fd);
+
+	if (pthread_create(&thread, NULL, irq_source, NULL)) {
+		fprintf(stderr, "pthread_create failed\n");
+		return -1;
+	}
+	pthread_detach(thread);
+
+	return 0;
+}
+
+static void cleanup_lock(void)
+{
+	shm_unlink(lock_name);
+}
+
+static int setup_lock(void)
+{
+	if (lock_name[0])
+		return 0;
+	if (setup_fpga())
+		return -1;
+
+	snprintf(lock_name, sizeof(lock_name), "/hwbench-lock.%d", getpid());
+	if (fpga_lock_open(lock_name))
+		return -1;
+	atexit(cleanup_lock);
+
+	return 0;
+}
+
+/* flock on a tmpfs file, what the FPGA lock replaces */
+static int setup_flock(void)
+{
+	char path[] = "/dev/shm/hwbench-flock.XXXXXX";
+
+	if (flock_fd != -1)
+		return 0;
+
+	flock_fd = mkstemp(path);
+	if (flock_fd == -1) {
+		perror("mkstemp");
+		return -1;
+	}
+	unlink(path);
+
+	return 0;
+}
+
+static void cleanup_telemetry(void)
+{
+	telemetry_destroy(telemetry, telemetry_shm_name);
+}
+
+/* The registers tshwctl --publish info samples on a TS-7250-V3 */
+static int setup_telemetry(void)
+{
+	static const uint32_t offs[] = { 0x0, 0x4, 0x8 };
+
+	if (telemetry)
+		return 0;
+	if (setup_fpga())
+		return -1;
+
+	snprintf(telemetry_shm_name, sizeof(telemetry_shm_name),
+	  "/hwbench-telemetry.%d", getpid());
+	telemetry = telemetry_create(telemetry_shm_name, 0x7250, offs, 3, 100);
+	if (telemetry == NULL)
+		return -1;
+	telemetry_publish(telemetry);
+	atexit(cleanup_telemetry);
+
+	return 0;
+}
+
+static void run_fpeek32(int n)
+{
+	while (n--)
+		sink = fpeek32(0x0);
+}
+
+static void run_fpoke32(int n)
+{
+	while (n--)
+		fpoke32(0x1c, n);
+}
+
+static void run_fpeek16(int n)
+{
+	while (n--)
+		sink = fpeek16(0x0);
+}
+
+static void run_fpoke16(int n)
+{
+	while (n--)
+		fpoke16(0x1c, n);
+}
+
+static void run_window_write(int n)
+{
+	while (n--) {
+		fpga_window_write(&win, 0, win_buf, 1024);
+		fpga_window_flush(&win);
+	}
+}
+
+static void run_io8_read(int n)
+{
+	while (n--)
+		sink = pc104_io_8_read(0x300);
+}
+
+static void run_io8_write(int n)
+{
+	while (n--)
+		pc104_io_8_write(0x300, n);
+}
+
+static void run_io16_read(int n)
+{
+	while (n--)
+		sink = pc104_io_16_read(0x300);
+}
+
+static void run_io16_write(int n)
+{
+	while (n--)
+		pc104_io_16_write(0x300, n);
+}
+
+static void run_io16_alt_read(int n)
+{
+	while (n--)
+		sink = pc104_io_16_alt_read(0x300);
+}
+
+static void run_io16_alt_write(int n)
+{
+	while (n--)
+		pc104_io_16_alt_write(0x300, n);
+}
+
+static void run_mem8_read(int n)
+{
+	while (n--)
+		sink = pc104_mem_8_read(0xd0000);
+}
+
+static void run_mem8_write(int n)
+{
+	while (n--)
+		pc104_mem_8_write(0xd0000, n);
+}
+
+static void run_mem16_read(int n)
+{
+	while (n--)
+		sink = pc104_mem_16_read(0xd0000);
+}
+
+static void run_mem16_write(int n)
+{
+	while (n--)
+		pc104_mem_16_write(0xd0000, n);
+}
+
+static void run_mem16_alt_read(int n)
+{
+	while (n--)
+		sink = pc104_mem_16_alt_read(0xd0000);
+}
+
+static void run_mem16_alt_write(int n)
+{
+	while (n--)
+		pc104_mem_16_alt_write(0xd0000, n);
+}
+
+#if defined(__arm__) && !defined(__thumb__)
+static void run_mmap_io8_read(int n)
+{
+	while (n--)
+		sink = bus_space[0x300];
+}
+
+static void run_mmap_io16_read(int n)
+{
+	while (n--)
+		sink = *(volatile uint16_t *)(bus_space + 0x300);
+}
+#endif
+
+/* Round trip of a kick to the source thread and the wakeup back */
+static void run_irq_wake(int n)
+{
+	const struct fpga_irq_cond cond = { IRQ_REG, 0x1, 0x1 };
+	uint64_t v = 1;
+
+	while (n--) {
+		fpoke32(IRQ_REG, 0);
+		if (write(irq_kick, &v, sizeof(v)) != sizeof(v))
+			return;
+		fpga_irq_wait(&irq, &cond, 1, -1);
+	}
+}
+
+static void run_fpga_lock(int n)
+{
+	while (n--) {
+		fpga_lock();
+		fpga_unlock();
+	}
+}
+
+static void run_fpga_rmw32(int n)
+{
+	while (n--)
+		fpga_rmw32(LOCK_REG, 0xff, n);
+}
+
+static void run_flock(int n)
+{
+	while (n--) {
+		flock(flock_fd, LOCK_EX);
+		flock(flock_fd, LOCK_UN);
+	}
+}
+
+static void run_telemetry_publish(int n)
+{
+	while (n--)
+		telemetry_publish(telemetry);
+}
+
+static void run_telemetry_read(int n)
+{
+	struct telemetry_snap snap;
+
+	while (n--)
+		telemetry_read(telemetry, &snap);
+	sink = snap.value[0];
+}
+
+static void run_lcd_write(int n)
+{
+	while (n--)
+		lcd_write(&lcd, 1, 'A' + (n & 0xf));
+}
+
+static void run_keypad_scan(int n)
+{
+	uint8_t keys[KEYPAD_KEYS], debounced[KEYPAD_KEYS];
+
+	while (n--) {
+		scan_keypad(&kp, keys);
+		debounce_keypad(keys, debounced);
+	}
+	sink = keys[5];
+}
+
+static void run_eval_cmd(int n)
+{
+	while (n--)
+		sink = eval_cmd("ts7100_straps");
+}
+
+static void run_eval_cmd_missing(int n)
+{
+	while (n--)
+		sink = eval_cmd("ts7100_nothere");
+}
+
+static void run_rgb565_frame(int n)
+{
+	while (n--)
+		rgb565_convert(out, rgb, SPLASH_W * SPLASH_H);
+}
+
+static void run_rgb565_ordered(int n)
+{
+	while (n--)
+		rgb565_convert_image(out, rgb, SPLASH_W, SPLASH_H,
+		  RGB565_DITHER_ORDERED);
+}
+
+static const struct bench benches[] = {
+	{ "fpeek32", 1000, setup_fpga, run_fpeek32 },
+	{ "fpoke32", 1000, setup_fpga, run_fpoke32 },
+	{ "fpeek16", 1000, setup_fpga, run_fpeek16 },
+	{ "fpoke16", 1000, setup_fpga, run_fpoke16 },
+	{ "fpga_window_write_4k", 10, setup_window, run_window_write },
+	{ "pc104_io_8_read", 100, setup_pc104, run_io8_read },
+	{ "pc104_io_8_write", 100, setup_pc104, run_io8_write },
+	{ "pc104_io_16_read", 100, setup_pc104, run_io16_read },
+	{ "pc104_io_16_write", 100, setup_pc104, run_io16_write },
+	{ "pc104_io_16_alt_read", 100, setup_pc104, run_io16_alt_read },
+	{ "pc104_io_16_alt_write", 100, setup_pc104, run_io16_alt_write },
+	{ "pc104_mem_8_read", 100, setup_pc104, run_mem8_read },
+	{ "pc104_mem_8_write", 100, setup_pc104, run_mem8_write },
+	{ "pc104_mem_16_read", 100, setup_pc104, run_mem16_read },
+	{ "pc104_mem_16_write", 100, setup_pc104, run_mem16_write },
+	{ "pc104_mem_16_alt_read", 100, setup_pc104, run_mem16_alt_read },
+	{ "pc104_mem_16_alt_write", 100, setup_pc104, run_mem16_alt_write },
+#if defined(__arm__) && !defined(__thumb__)
+	{ "pc104_mmap_io8_read", 100, setup_pc104_mmap, run_mmap_io8_read },
+	{ "pc104_mmap_io16_read", 100, setup_pc104_mmap, run_mmap_io16_read },
+#else
+	/* The mapped window is only reached with ARM-mode bus_space code */
+	{ "pc104_mmap_io8_read", 100, NULL, NULL },
+	{ "pc104_mmap_io16_read", 100, NULL, NULL },
+#endif
+	{ "fpga_irq_wake", 10, setup_irq, run_irq_wake },
+	{ "fpga_lock", 1000, setup_lock, run_fpga_lock },
+	{ "fpga_rmw32", 1000, setup_lock, run_fpga_rmw32 },
+	{ "flock", 100, setup_flock, run_flock },
+	{ "telemetry_publish", 1000, setup_telemetry, run_telemetry_publish },
+	{ "telemetry_read", 1000, setup_telemetry, run_telemetry_read },
+	{ "lcd_write", 10, setup_lcd_poll, run_lcd_write },
+	{ "lcd_write_timed", 10, setup_lcd_timed, run_lcd_write },
+	{ "keypad_scan", 10, setup_keypad, run_keypad_scan },
+	{ "eval_cmd", 1000, setup_eval, run_eval_cmd },
+	{ "eval_cmd_missing", 1000, setup_eval, run_eval_cmd_missing },
+	{ "rgb565_frame", 1, setup_rgb565, run_rgb565_frame },
+	{ "rgb565_ordered", 1, setup_rgb565, run_rgb565_ordered },
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int run_bench(const struct bench *b, int samples)
+{
+	double *per_op;
+	uint64_t start, t, total = 0;
+	int i;
+
+	if (!b->setup) {
+		printf("{\"name\":\"%s\",\"skipped\":\"arch\"}\n", b->name);
+		return 0;
+	}
+	if (b->setup()) {
+		printf("{\"name\":\"%s\",\"error\":\"setup failed\"}\n", b->name);
+		return -1;
+	}
+
+	per_op = malloc(samples * sizeof(double));
+	if (!per_op) {
+		perror("malloc");
+		return -1;
+	}
+
+	/* One untimed batch to warm caches and fault in mappings */
+	b->run(b->batch);
+
+	for (i = 0; i < samples; i++) {
+		start = now_ns();
+		b->run(b->batch);
+		t = now_ns() - start;
+		total += t;
+		per_op[i] = (double)t / b->batch;
+	}
+	qsort(per_op, samples, sizeof(double), cmp_double);
+
+	printf("{\"name\":\"%s\",\"ops\":%llu,\"ops_per_sec\":%.0f,"
+	  "\"p50_ns\":%.1f,\"p99_ns\":%.1f}\n", b->name,
+	  (unsigned long long)samples * b->batch,
+	  total ? (double)samples * b->batch * 1e9 / total : 0.0,
+	  per_op[samples / 2], per_op[(samples * 99) / 100]);
+	fflush(stdout);
+	free(per_op);
+
+	return 0;
+}
+
+static int increment(void *arg)
+{
+	fpoke32(LOCK_REG, fpeek32(LOCK_REG) + 1);
+
+	return 0;
+}
+
+static int lock_stress(int procs)
+{
+	struct fpga_lock_stats st;
+	uint64_t start, t;
+	uint32_t want, got;
+	pid_t pid;
+	int i, j, status, failed = 0;
+	int go[2];
+	char c;
+
+	if (setup_lock())
+		return 1;
+	fpoke32(LOCK_REG, 0);
+
+	/* A holder that exits without unlocking */
+	pid = fork();
+	if (pid == 0) {
+		fpga_lock();
+		_exit(0);
+	}
+	waitpid(pid, NULL, 0);
+
+	/* Children start together when the pipe is closed, so they overlap */
+	if (pipe(go)) {
+		perror("pipe");
+		return 1;
+	}
+	for (i = 0; i < procs; i++) {
+		pid = fork();
+		if (pid == -1) {
+			perror("fork");
+			return 1;
+		}
+		if (pid == 0) {
+			close(go[1]);
+			if (read(go[0], &c, 1) != 0)
+				_exit(1);
+			for (j = 0; j < STRESS_OPS; j++)
+				fpga_transaction(increment, NULL);
+			_exit(0);
+		}
+	}
+	start = now_ns();
+	close(go[0]);
+	close(go[1]);
+	for (i = 0; i < procs; i++) {
+		if (wait(&status) == -1 || !WIFEXITED(status) ||
+		  WEXITSTATUS(status))
+			failed = 1;
+	}
+	t = now_ns() - start;
+
+	want = procs * STRESS_OPS;
+	got = fpeek32(LOCK_REG);
+	fpga_lock_stats(&st);
+
+	printf("{\"name\":\"fpga_lock_stress\",\"procs\":%d,\"ops\":%u,"
+	  "\"lost\":%d,\"contended\":%llu,\"owner_died\":%llu,"
+	  "\"ops_per_sec\":%.0f}\n", procs, want, (int)(want - got),
+	  (unsigned long long)st.contended,
+	  (unsigned long long)st.owner_died, want * 1e9 / t);
+
+	return failed || got != want || st.owner_died != 1;
+}
+
+static void usage(char **argv)
+{
+	fprintf(stderr,
+	  "Usage: %s [OPTION] ... [NAME] ...\n"
+	  "Benchmark hardware access paths against simulated backends\n"
+	  "\n"
+	  "  -n, --samples <num>    Timed batches per benchmark, default %d\n"
+	  "  -l, --list             List benchmark names\n"
+	  "  -s, --lock-stress <n>  Check n processes never lose an update\n"
+	  "                         under the FPGA lock, instead of benchmarking\n"
+	  "  --stats                Enable instrumentation while benchmarking\n"
+	  "  -h, --help             This message\n"
+	  "\n"
+	  "  With NAME arguments only benchmarks whose name starts with one\n"
+	  "  of them are run.  Results are JSON, one object per line.\n"
+	  "\n",
+	  argv[0], SAMPLES_DEFAULT
+	);
+}
+
+int main(int argc, char **argv)
+{
+	int c, i, j, samples = SAMPLES_DEFAULT, ret = 0, selected;
+	int stress = 0;
+
+	static struct option long_options[] = {
+	  { "samples", required_argument, NULL, 'n' },
+	  { "list", no_argument, NULL, 'l' },
+	  { "lock-stress", required_argument, NULL, 's' },
+	  { "help", no_argument, NULL, 'h' },
+	  { NULL, no_argument, NULL, 0 }
+	};
+
+	/* With --stats the benchmarks include the instrumentation cost */
+	stats_init(&argc, argv);
+
+	while((c = getopt_long(argc, argv, "n:ls:h", long_options, NULL)) != -1) {
+		switch (c) {
+		  case 'n':
+			samples = atoi(optarg);
+			break;
+		  case 'l':
+			for (i = 0; i < sizeof(benches)/sizeof(benches[0]); i++)
+				printf("%s\n", benches[i].name);
+			return 0;
+		  case 's':
+			stress = atoi(optarg);
+			break;
+		  case 'h':
+		  default:
+			usage(argv);
+			return 1;
+		}
+	}
+
+	if (samples < 1) {
+		usage(argv);
+		return 1;
+	}
+
+	if (stress > 0)
+		return lock_stress(stress);
+
+	for (i = 0; i < sizeof(benches)/sizeof(benches[0]); i++) {
+		selected = (optind == argc);
+		for (j = optind; j < argc; j++)
+			if (!strncmp(benches[i].name, argv[j], strlen(argv[j])))
+				selected = 1;
+		if (selected && run_bench(&benches[i], samples))
+			ret = 1;
+	}
+
+	return ret;
+}
@@ -1,112 +1,94 @@
+#include <getopt.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
-#include <gpiod.h>
-#include <unistd.h>
-#include <assert.h>
-#include <sys/time.h>
 #include "helpers.h"
+#include "keypad_scan.h"
+#include "rt.h"
+#include "stats.h"
 
-struct gpiod_chip *chip;
-struct gpiod_line_bulk dout;
-struct gpiod_line_bulk din;
+/* Poll at ~100hz */
+#define SCAN_NS		10000000
 
-const char *key_label[16] = {
-	"1", "2", "3", "UP",
-	"4", "5", "6", "DOWN",
-	"7", "8", "9", "2ND",
-	"CLEAR", "0", "HELP", "ENTER",
-};
+static volatile sig_atomic_t quit;
 
-void set_4bit_array(int *val, uint8_t data)
+static void on_signal(int sig)
 {
-	val[0] = data & (1 << 0);
-	val[1] = data & (1 << 1);
-	val[2] = data & (1 << 2);
-	val[3] = data & (1 << 3);
+	quit = 1;
 }
 
-void scan_keypad(uint8_t *keys)
+static void usage(char **argv)
 {
-	int key;
-	int lines[4];
-	int r;
-	uint8_t row, col;
-	memset(keys, 0, 16);
-
-	for (row = 0; row < 4; row++) {
-		set_4bit_array(lines, ~(1 << row));
-		r = gpiod_line_set_value_bulk(&dout, lines);
-		assert (!r);
-		r = gpiod_line_get_value_bulk(&din, lines);
-		assert (!r);
-		for (col = 0; col < 4; col++) {
-			key = (row * 4) + col;
-			if (!lines[col]) {
-				keys[key] = 1;
-			}
-		}
-	}
+	fprintf(stderr,
+	  "Usage: %s [OPTION] ...\n"
+	  "Print TS-7250-V3 keypad presses, one per line\n"
+	  "\n"
+	  RT_USAGE
+	  "  -j, --jitter           Report scan period jitter on exit\n"
+	  "  --stats                Report bus access counts and timing at exit\n"
+	  "  -h, --help             This message\n"
+	  "\n",
+	  argv[0]
+	);
 }
 
-void debounce_keypad(uint8_t *keys, uint8_t *debounced)
+int main(int argc, char **argv)
 {
-	struct timeval exptime, now, maxtime;
-	static struct timeval db[16];
-	int i, ret;
-	memset(debounced, 0, 16);
+	int c, i;
+	int opt_prio = 0, opt_cpu = -1, opt_jitter = 0;
+	struct keypad kp;
+	struct rt_period period;
+	struct sigaction act;
+	uint8_t keys[16], debounced[16], oldstate[16];
+	memset(oldstate, 0, 16);
 
-	/* Require minimum press of 50ms. */
-	exptime.tv_sec = 0;
-	exptime.tv_usec = 1000 * 50;
+	static struct option long_options[] = {
+	  RT_LONG_OPTIONS,
+	  { "jitter", no_argument, NULL, 'j' },
+	  { "help", no_argument, NULL, 'h' },
+	  { NULL, no_argument, NULL, 0 }
+	};
 
-	ret = gettimeofday(&now, NULL);
-	assert(!ret);
-	for (i = 0; i < 16; i++) {
-		if (keys[i]){
-			if (!timerisset(&db[i])) {
-				db[i] = now;
-				continue;
-			} else {
-				timeradd(&db[i], &exptime, &maxtime);
-				/* Debounce until exptime */
-				if(timercmp(&maxtime, &now, >))
-					continue;
-				debounced[i] = 1;
-			}
+	stats_init(&argc, argv);
+
+	while((c = getopt_long(argc, argv, "jh", long_options, NULL)) != -1) {
+		switch (c) {
+		  case RT_OPT_PRIO:
+		  case RT_OPT_CPU:
+			if (rt_parse(c, optarg, &opt_prio, &opt_cpu))
+				return 1;
+			break;
+		  case 'j':
+			opt_jitter = 1;
+			break;
+		  case 'h':
+		  default:
+			usage(argv);
+			return 1;
 		}
-		timerclear(&db[i]);
 	}
-}
-
-int main()
-{
-	int ret, i;
-	unsigned int out_pins[4] = {1, 2, 3, 4};
-	unsigned int in_pins[4] = {6, 7, 8, 9};
-	uint8_t keys[16], debounced[16], oldstate[16];
-	memset(oldstate, 0, 16);
 
 	if(get_model() != 0x7250) {
 		fprintf(stderr, "This is only supported on the TS-7250-V3\n");
 		return 1;
 	}
 
-	chip = gpiod_chip_open_by_number(5);
-	assert(chip);
-	gpiod_line_bulk_init(&dout);
-	gpiod_line_bulk_init(&din);
-	ret = gpiod_chip_get_lines(chip, out_pins, 4, &dout);
-	assert(!ret);
-	ret = gpiod_chip_get_lines(chip, in_pins, 4, &din);
-	assert(!ret);
-	ret = gpiod_line_request_bulk_output(&dout, "keypad rows", NULL);
-	assert(!ret);
-	ret = gpiod_line_request_bulk_input(&din, "keypad cols");
-	assert(!ret);
+	keypad_init(&kp);
 
-	while(1) {
-		scan_keypad(keys);
+	if (rt_enable(opt_prio, opt_cpu))
+		return 1;
+
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = on_signal;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+
+	/* Scans start on absolute deadlines, the time taken by a scan does
+	 * not stretch the period */
+	rt_period_init(&period, SCAN_NS);
+	while(!quit) {
+		scan_keypad(&kp, keys);
 		debounce_keypad(keys, debounced);
 		for (i = 0; i < 16; i++) {
 			if(keys[i] && oldstate[i])
@@ -121,9 +103,11 @@ int main()
 				oldstate[i] = 0;
 			}
 		}
-		/* Poll at ~100hz */
-		usleep(10000);
+		rt_period_wait(&period);
 	}
 
+	if (opt_jitter)
+		rt_period_report(&period, stderr);
+
 	return 0;
 }
@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Scanning and debouncing of the TS-7250-V3 keypad header */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <gpiod.h>
+#include <assert.h>
+#include <sys/time.h>
+#include "keypad_scan.h"
+#include "stats.h"
+
+const char *key_label[KEYPAD_KEYS] = {
+	"1", "2", "3", "UP",
+	"4", "5", "6", "DOWN",
+	"7", "8", "9", "2ND",
+	"CLEAR", "0", "HELP", "ENTER",
+};
+
+static void set_4bit_array(int *val, uint8_t data)
+{
+	val[0] = data & (1 << 0);
+	val[1] = data & (1 << 1);
+	val[2] = data & (1 << 2);
+	val[3] = data & (1 << 3);
+}
+
+void keypad_init(struct keypad *kp)
+{
+	int ret;
+	unsigned int out_pins[4] = {1, 2, 3, 4};
+	unsigned int in_pins[4] = {6, 7, 8, 9};
+
+	kp->chip = gpiod_chip_open_by_number(5);
+	assert(kp->chip);
+	gpiod_line_bulk_init(&kp->dout);
+	gpiod_line_bulk_init(&kp->din);
+	ret = gpiod_chip_get_lines(kp->chip, out_pins, 4, &kp->dout);
+	assert(!ret);
+	ret = gpiod_chip_get_lines(kp->chip, in_pins, 4, &kp->din);
+	assert(!ret);
+	ret = gpiod_line_request_bulk_output(&kp->dout, "keypad rows", NULL);
+	assert(!ret);
+	ret = gpiod_line_request_bulk_input(&kp->din, "keypad cols");
+	assert(!ret);
+}
+
+void scan_keypad(struct keypad *kp, uint8_t *keys)
+{
+	struct stats_mark m;
+	int key;
+	int lines[4];
+	int r;
+	uint8_t row, col;
+	memset(keys, 0, KEYPAD_KEYS);
+
+	stats_begin(&m);
+	for (row = 0; row < 4; row++) {
+		set_4bit_array(lines, ~(1 << row));
+		r = gpiod_line_set_value_bulk(&kp->dout, lines);
+		assert (!r);
+		r = gpiod_line_get_value_bulk(&kp->din, lines);
+		assert (!r);
+		for (col = 0; col < 4; col++) {
+			key = (row * 4) + col;
+			if (!lines[col]) {
+				keys[key] = 1;
+			}
+		}
+	}
+	stats_end(STATS_KEYPAD_SCAN, &m);
+	stats_add(STATS_GPIO_WRITE, 4);
+	stats_add(STATS_GPIO_READ, 4);
+	stats_add(STATS_SYSCALLS, 8);
+}
+
+void debounce_keypad(uint8_t *keys, uint8_t *debounced)
+{
+	struct timeval exptime, now, maxtime;
+	static struct timeval db[KEYPAD_KEYS];
+	int i, ret;
+	memset(debounced, 0, KEYPAD_KEYS);
+
+	/* Require minimum press of 50ms. */
+	exptime.tv_sec = 0;
+	exptime.tv_usec = 1000 * 50;
+
+	ret = gettimeofday(&now, NULL);
+	assert(!ret);
+	for (i = 0; i < KEYPAD_KEYS; i++) {
+		if (keys[i]){
+			if (!timerisset(&db[i])) {
+				db[i] = now;
+				continue;
+			} else {
+				timeradd(&db[i], &exptime, &maxtime);
+				/* Debounce until exptime */
+				if(timercmp(&maxtime, &now, >))
+					continue;
+				debounced[i] = 1;
+			}
+		}
+		timerclear(&db[i]);
+	}
+}
@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __KEYPAD_SCAN_H__
+#define __KEYPAD_SCAN_H__
+
+#include <stdint.h>
+#include <gpiod.h>
+
+#define KEYPAD_KEYS	16
+
+/* 4x4 matrix keypad, rows driven low one at a time and columns read back */
+struct keypad {
+	struct gpiod_chip *chip;
+	struct gpiod_line_bulk dout;
+	struct gpiod_line_bulk din;
+};
+
+extern const char *key_label[KEYPAD_KEYS];
+
+void keypad_init(struct keypad *kp);
+
+/* Set keys[n] for every key currently closed */
+void scan_keypad(struct keypad *kp, uint8_t *keys);
+
+/* Set debounced[n] for keys that have been held for at least 50ms */
+void debounce_keypad(uint8_t *keys, uint8_t *debounced);
+
+#endif //__KEYPAD_SCAN_H__
@@ -1,189 +1,393 @@
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 #include <string.h>
 #include <stdint.h>
-#include <gpiod.h>
-#include <errno.h>
-#include <assert.h>
-#include <time.h>
 #include <unistd.h>
-#include "helpers.h"
-#include "fpga.h"
+#include <sys/socket.h>
+#include <poll.h>
+#include <time.h>
+#include "hd44780.h"
+#include "lcdsock.h"
+#include "rt.h"
+#include "stats.h"
 
-#define CONSUMER "lcdmesg"
+static uint16_t lcd_bias_value;
 
-uint16_t lcd_bias_value;
+#define STREAM_LINE_MAX		512
+#define STREAM_RATE		20
+#define STREAM_DRAIN_MAX	65536	/* Bytes read between frame checks */
 
-struct hd44780 {
-	struct gpiod_chip *chip;
-	struct gpiod_line_bulk data;
-	struct gpiod_line *en;
-	struct gpiod_line *rs;
-	struct gpiod_line *wr;
-};
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig)
+{
+	quit = 1;
+}
+
+static void print_glyph_stats(struct hd44780 *lcd)
+{
+	fprintf(stderr, "glyph_hits=%lu glyph_misses=%lu glyph_evictions=%lu\n",
+	  lcd->glyph_hits, lcd->glyph_misses, lcd->glyph_evictions);
+}
 
-void set_8bit_array(int *val, uint8_t data)
+static void usage(char **argv)
 {
-	val[0] = data & (1 << 0);
-	val[1] = data & (1 << 1);
-	val[2] = data & (1 << 2);
-	val[3] = data & (1 << 3);
-	val[4] = data & (1 << 4);
-	val[5] = data & (1 << 5);
-	val[6] = data & (1 << 6);
-	val[7] = data & (1 << 7);
+	fprintf(stderr,
+	  "Usage: %s [OPTION] [line1] [line2] ...\n"
+	  "Write lines to the character LCD, or read lines from stdin\n"
+	  "\n"
+	  "  -d, --daemon           Initialize the LCD once and take updates\n"
+	  "                         from other lcdmesg processes\n"
+	  "  -s, --socket <path>    Daemon socket, default %s\n"
+	  "  -m, --marquee <ms>     Scroll the lines, one step every <ms>.  Not\n"
+	  "                         with the default geometry, LCD_GEOMETRY must\n"
+	  "                         start row 2 at 0x40, such as 24x2\n"
+	  "  -r, --rate <fps>       Maximum frame rate reading stdin, default %d\n"
+	  "                         (0 for no limit).  Only the latest line for\n"
+	  "                         each row is shown\n"
+	  "  -v, --verbose          Report glyph cache and frame counters, and\n"
+	  "                         marquee jitter, on exit\n"
+	  RT_USAGE
+	  "  --stats                Report bus access counts and timing at exit\n"
+	  "  -h, --help             This message\n"
+	  "\n"
+	  "Options end at the first line that is not one, or at --.\n"
+	  "\n"
+	  "When a daemon is running, updates are handed to it rather than\n"
+	  "re-initializing the LCD.  Text may contain custom 5x8 glyphs as\n"
+	  "\\g followed by 16 hex digits, one byte per row top to bottom.\n"
+	  "\n"
+	  "Environment: LCD_CONTRAST (0-15), LCD_GEOMETRY, LCD_BUSY_POLL,\n"
+	  "LCDMESG_SOCKET, TS_STATS.\n"
+	  "\n",
+	  argv[0], LCDSOCK_PATH, STREAM_RATE
+	);
 }
 
-void nsleep(long int nsec)
+/* Serve display updates until SIGINT or SIGTERM.  The socket is not
+ * created until the LCD is ready so clients never queue updates behind
+ * the init sequence. */
+static int run_daemon(struct hd44780 *lcd, const char *path)
 {
-	struct timespec target, leftover;
-	int ret;
+	struct sigaction act;
+	char msg[LCDSOCK_MSG_MAX];
+	ssize_t len;
+	int fd;
 
-	target.tv_sec = 0;
-	target.tv_nsec = nsec;
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = on_signal;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
 
-	ret = nanosleep(&target, &leftover);
-	if(ret == -1)
-		if (errno == -EINTR)
-			nsleep(leftover.tv_nsec);
+	fd = lcdsock_listen(path);
+	if (fd == -1) {
+		perror(path);
+		return 1;
+	}
+
+	while (!quit) {
+		len = recv(fd, msg, sizeof(msg), 0);
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("recv");
+			break;
+		}
+		lcdsock_apply(lcd, msg, len);
+	}
+
+	close(fd);
+	unlink(path);
+
+	return 0;
 }
-uint8_t get_8bit_array(int *val)
+
+/* Scroll the given rows until SIGINT or SIGTERM, one step per interval on
+ * absolute deadlines */
+static int run_marquee(struct hd44780 *lcd, int interval_ms, int argc,
+  char **argv, int verbose)
 {
-	uint8_t ret;
-	ret = (val[0] << 0);
-	ret |= (val[1] << 1);
-	ret |= (val[2] << 2);
-	ret |= (val[3] << 3);
-	ret |= (val[4] << 4);
-	ret |= (val[5] << 5);
-	ret |= (val[6] << 6);
-	ret |= (val[7] << 7);
-	return ret;
+	struct lcd_marquee m;
+	struct sigaction act;
+	struct rt_period period;
+
+	if (lcd_marquee_init(lcd, &m, argc, argv) < 0) {
+		fprintf(stderr, "Marquee needs each row on its own DDRAM line, "
+		  "set LCD_GEOMETRY\n");
+		return 1;
+	}
+
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = on_signal;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+
+	rt_period_init(&period, interval_ms * 1000000ULL);
+	while (!quit) {
+		rt_period_wait(&period);
+		lcd_marquee_step(lcd, &m);
+	}
+
+	if (verbose)
+		rt_period_report(&period, stderr);
+
+	return 0;
 }
 
-/* https://www.sparkfun.com/datasheets/LCD/HD44780.pdf
- * Sheet 58 */
-void lcd_write(struct hd44780 *lcd, uint8_t rs, uint8_t data)
+struct stream {
+	char line[LCD_MAX_ROWS][STREAM_LINE_MAX];
+	size_t len[LCD_MAX_ROWS];
+	int dirty[LCD_MAX_ROWS];
+	int row;
+	char part[STREAM_LINE_MAX];	/* Line still being read */
+	size_t partial;
+	unsigned long frames;
+	unsigned long dropped;
+};
+
+static uint64_t now_ms(void)
 {
-	int val[8];
-	set_8bit_array(val, data);
-
-	gpiod_line_set_value(lcd->rs, rs);
-	gpiod_line_set_value(lcd->wr, 0);
-	gpiod_line_set_value_bulk(&lcd->data, val);
-	nsleep(60); /* tAS */
-	gpiod_line_set_value(lcd->en, 1);
-	nsleep(230); /* PWEH */
-	gpiod_line_set_value(lcd->en, 0);
-	nsleep(210); /* tH/tAH + tcycE */
-
-	usleep(37);
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-/* Set a contrast (duty cycle) from 0 (off) to 15 (max).
- * This may need to change depending on the LCD used or the altitude */
-void lcd_contrast(uint8_t duty)
+/* Finish the line being read.  Lines rotate through the rows, and a line
+ * replacing one that was never displayed counts as a dropped frame. */
+static void stream_commit(struct stream *st, int rows)
 {
-	fpoke32(0x1c, duty & 0xf);
+	if (st->dirty[st->row])
+		st->dropped++;
+	memcpy(st->line[st->row], st->part, st->partial);
+	st->len[st->row] = st->partial;
+	st->dirty[st->row] = 1;
+	st->partial = 0;
+	st->row = (st->row + 1) % rows;
 }
 
-void lcd_writechars(struct hd44780 *lcd, char *dat)
+static void stream_input(struct stream *st, int rows, const char *buf,
+  size_t len)
 {
-	while(*dat)
-		lcd_write(lcd, 1, *dat++);
+	for (; len; len--, buf++) {
+		if (*buf == '\n') {
+			stream_commit(st, rows);
+			continue;
+		}
+		/* Overlong lines are truncated, the display is narrower.  The
+		 * row keeps its last whole line until this one is complete. */
+		if (st->partial < STREAM_LINE_MAX)
+			st->part[st->partial++] = *buf;
+	}
 }
 
-void lcd_returnhome(struct hd44780 *lcd)
+/* Show the latest content of every row that changed, either directly or as
+ * a single datagram to the daemon. */
+static void stream_render(struct stream *st, struct hd44780 *lcd, int rows,
+  const char *sockpath)
 {
-	/* Since we cannot poll busy, the write function waits the typical 37us
-	 * execution time max.  Clear home must wait 1.52ms, but all other
-	 * commands are 37us.
-	 */
-	lcd_write(lcd, 0, 0x2);
-	usleep(1520);
+	char msg[LCDSOCK_MSG_MAX];
+	int row, len = 0;
+
+	for (row = 0; row < rows; row++) {
+		if (!st->dirty[row])
+			continue;
+		st->dirty[row] = 0;
+		if (lcd) {
+			lcd_update_row(lcd, row, st->line[row], st->len[row]);
+		} else {
+			len += snprintf(msg + len, sizeof(msg) - len, "%d:%.*s\n",
+			  row, (int)st->len[row], st->line[row]);
+			if (len >= sizeof(msg))
+				len = sizeof(msg) - 1;
+		}
+	}
+	if (!lcd && len)
+		lcdsock_send(sockpath, msg, len);
+	st->frames++;
 }
 
-void lcd_init(struct hd44780 *lcd)
+/* Render lines from stdin at no more than rate frames per second.  All
+ * pending input is drained before each frame and only the newest line for
+ * each row is shown, so a fast producer never waits on the LCD beyond what
+ * the pipe buffer absorbs during a single frame.
+ */
+static int run_stream(struct hd44780 *lcd, const struct lcd_geometry *geo,
+  const char *sockpath, int rate, int verbose)
 {
-	int ret;
-	int model;
-
-	model = get_model();
-	if(model == 0x7250){
-		unsigned int datapins[8] = {10, 9, 12, 11, 16, 15, 18, 17};
-
-		lcd->chip = gpiod_chip_open_by_number(2);
-		assert(lcd->chip);
-		gpiod_line_bulk_init(&lcd->data);
-		ret = gpiod_chip_get_lines(lcd->chip, datapins, 8, &lcd->data);
-		assert(!ret);
-		lcd->en = gpiod_chip_get_line(lcd->chip, 20);
-		assert(lcd->en);
-		lcd->rs = gpiod_chip_get_line(lcd->chip, 21);
-		assert(lcd->rs);
-		lcd->wr = gpiod_chip_get_line(lcd->chip, 19);
-		assert(lcd->wr);
-	} else {
-		fprintf(stderr, "Unsupported model 0x%X\n", model);
-		exit(1);
-	}
-
-	fpga_init(0x50004000);
-
-	/* Initialize all IO as high */
-	ret = gpiod_line_request_bulk_output(&lcd->data, CONSUMER, NULL);
-	ret |= gpiod_line_request_output(lcd->en, CONSUMER, 1);
-	ret |= gpiod_line_request_output(lcd->rs, CONSUMER, 1);
-	ret |= gpiod_line_request_output(lcd->wr, CONSUMER, 1);
-	assert(!ret);
-
-	/* Recover from any potential state to 8-bit mode, and set:
-	 * Function Set
-	 * DL = 1 (8-bits)
-	 * N = 1 (2 line)
-	 * F = 0 (5x8 dots)
-	 */
-	lcd_write(lcd, 0, 0x38);
-	lcd_write(lcd, 0, 0x38);
-	lcd_write(lcd, 0, 0x38);
-
-	/*
-	 * Entry Mode Set
-	 * I/D = 1 (increment)
-	 * S = 0 (display shift off)
-	 */
-	lcd_write(lcd, 0, 0x6);
-
-	/*
-	 * Display on/off Control
-	 * D = 1 (display on)
-	 * C = 0 (cursor off)
-	 * B = 0 (cursor blink off)
-	 */
-	lcd_write(lcd, 0, 0xc);
-
-	/*
-	 * Clear Display
-	 */
-	lcd_write(lcd, 0, 0x1);
-
-	/*
-	 * Return home
-	 */
-	lcd_returnhome(lcd);
-
-
-	lcd_contrast(lcd_bias_value);
+	static struct stream st;
+	struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+	uint64_t next_frame = 0, now;
+	char buf[4096];
+	int eof = 0, pending, timeout, row;
+	size_t drained;
+	ssize_t len;
+
+	while (!eof) {
+		pending = 0;
+		for (row = 0; row < geo->rows; row++)
+			pending |= st.dirty[row];
+
+		timeout = -1;
+		if (pending) {
+			now = now_ms();
+			timeout = (next_frame > now) ? next_frame - now : 0;
+		}
+
+		if (poll(&pfd, 1, timeout) == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			return 1;
+		}
+
+		/* Drain what is available without blocking, but no more than
+		 * STREAM_DRAIN_MAX so a producer that never pauses still lets
+		 * frames be rendered */
+		for (drained = 0; pfd.revents && drained < STREAM_DRAIN_MAX;
+		  drained += len) {
+			len = read(STDIN_FILENO, buf, sizeof(buf));
+			if (len <= 0) {
+				if (len == -1 && errno == EINTR) {
+					len = 0;
+					continue;
+				}
+				eof = 1;
+				break;
+			}
+			stream_input(&st, geo->rows, buf, len);
+			if (poll(&pfd, 1, 0) == -1)
+				break;
+		}
+
+		if (eof && st.partial)
+			stream_commit(&st, geo->rows);
+
+		now = now_ms();
+		if (eof || now >= next_frame) {
+			pending = 0;
+			for (row = 0; row < geo->rows; row++)
+				pending |= st.dirty[row];
+			if (pending) {
+				stream_render(&st, lcd, geo->rows, sockpath);
+				next_frame = now_ms() + (rate ? 1000 / rate : 0);
+			}
+		}
+	}
+
+	if (verbose)
+		fprintf(stderr, "frames=%lu dropped=%lu\n", st.frames,
+		  st.dropped);
+
+	return 0;
+}
+
+/* Message text may start with '-', as in "-12.5 C", so options end at the
+ * first argument that is not made of the short options below, or a long
+ * option.  "--" ends them explicitly. */
+static int is_option(const char *arg)
+{
+	const char *p;
+
+	if (arg[0] != '-' || arg[1] == '\0')
+		return 0;
+	if (arg[1] == '-')
+		return 1;
+
+	for (p = arg + 1; *p; p++) {
+		if (strchr("smr", *p))
+			return 1;	/* The rest is its argument */
+		if (!strchr("dvh", *p))
+			return 0;
+	}
+	return 1;
+}
+
+/* Hand the command line rows to a running daemon.  Returns -1 if there is
+ * no daemon, in which case the LCD is driven directly. */
+static int send_args(const char *path, int argc, char **argv)
+{
+	char msg[LCDSOCK_MSG_MAX];
+	int i, len = 0;
+
+	for (i = 0; i < argc; i++) {
+		len += snprintf(msg + len, sizeof(msg) - len, "%d:%s\n", i,
+		  argv[i]);
+		if (len >= sizeof(msg))
+			len = sizeof(msg) - 1;
+	}
+
+	return lcdsock_send(path, msg, len);
 }
 
 int main(int argc, char **argv)
 {
 	struct hd44780 lcd;
-	int i = 0;
+	const struct lcd_geometry *geo;
+	int c, row = 0;
+	int opt_daemon = 0, opt_verbose = 0, opt_marquee = 0, use_daemon;
+	int opt_rate = STREAM_RATE;
+	int opt_prio = 0, opt_cpu = -1;
+	const char *sockpath = lcdsock_path();
 	char *contrast = getenv("LCD_CONTRAST");
+	char *geometry = getenv("LCD_GEOMETRY");
+	char *busy_poll = getenv("LCD_BUSY_POLL");
+
+	static struct option long_options[] = {
+	  { "daemon", no_argument, NULL, 'd' },
+	  { "socket", required_argument, NULL, 's' },
+	  { "marquee", required_argument, NULL, 'm' },
+	  { "rate", required_argument, NULL, 'r' },
+	  { "verbose", no_argument, NULL, 'v' },
+	  RT_LONG_OPTIONS,
+	  { "help", no_argument, NULL, 'h' },
+	  { NULL, no_argument, NULL, 0 }
+	};
+
+	stats_init(&argc, argv);
+
+	while(optind < argc && is_option(argv[optind]) &&
+	  (c = getopt_long(argc, argv, "+ds:m:r:vh", long_options, NULL)) != -1) {
+		switch (c) {
+		  case 'd':
+			opt_daemon = 1;
+			break;
+		  case 's':
+			sockpath = optarg;
+			break;
+		  case 'm':
+			opt_marquee = strtoul(optarg, NULL, 0);
+			if (opt_marquee <= 0) {
+				fprintf(stderr, "Marquee interval must be > 0\n");
+				return 1;
+			}
+			break;
+		  case 'r':
+			opt_rate = atoi(optarg);
+			if (opt_rate < 0 || opt_rate > 1000) {
+				fprintf(stderr, "Frame rate must be 0-1000\n");
+				return 1;
+			}
+			break;
+		  case 'v':
+			opt_verbose = 1;
+			break;
+		  case RT_OPT_PRIO:
+		  case RT_OPT_CPU:
+			if (rt_parse(c, optarg, &opt_prio, &opt_cpu))
+				return 1;
+			break;
+		  case 'h':
+		  default:
+			usage(argv);
+			return 1;
+		}
+	}
+	argc -= optind;
+	argv += optind;
 
 	/* Contrast can be 0-15.  Default to 12 if not specified. */
 	if(contrast) {
@@ -195,35 +399,78 @@ int main(int argc, char **argv)
 		lcd_bias_value = 12;
 	}
 
-	lcd_init(&lcd);
-	if (argc == 2) {
-		lcd_writechars(&lcd, argv[1]);
-		return 0;
+	/* Row addresses differ between LCD sizes, default to the layout
+	 * lcdmesg has always used. */
+	geo = lcd_geometry_lookup(geometry);
+	if (!geo) {
+		fprintf(stderr, "Unknown LCD_GEOMETRY \"%s\", supported:",
+		  geometry);
+		lcd_geometry_list(stderr, 0);
+		return 1;
+	}
+
+	if (opt_marquee && (opt_daemon || argc < 1)) {
+		fprintf(stderr, "Marquee takes its lines from the command line\n");
+		return 1;
+	}
+
+	if (opt_marquee && !lcd_marquee_geometry(geo)) {
+		fprintf(stderr, "Marquee needs each row on its own DDRAM line, "
+		  "set LCD_GEOMETRY to one of:");
+		lcd_geometry_list(stderr, 1);
+		return 1;
 	}
-	if (argc > 2) {
-		lcd_writechars(&lcd, argv[1]);
-		/* set DDRAM addr to second row */
-		lcd_write(&lcd, 0, 0xa8);
-		lcd_writechars(&lcd, argv[2]);
+
+	if (!opt_daemon && !opt_marquee && argc >= 1 &&
+	  !send_args(sockpath, argc, argv))
 		return 0;
+
+	/* Probe with an empty datagram, the daemon ignores it */
+	use_daemon = !opt_daemon && !lcdsock_send(sockpath, "", 0);
+	if (use_daemon && opt_marquee) {
+		fprintf(stderr, "Marquee drives the LCD directly, stop the "
+		  "lcdmesg daemon first\n");
+		return 1;
 	}
-	while(!feof(stdin)) {
-		char buf[512];
-		if (i) {
-			/* XXX: this seek addr may be different for different
-			 * LCD sizes!  -JO */
-			lcd_write(&lcd, 0, 0xa8);
-		} else {
-			lcd_returnhome(&lcd);
-		}
-		i = i ^ 0x1;
-		if (fgets(&buf[0], sizeof(buf), stdin) != NULL) {
-			unsigned int len;
-			buf[0x27] = 0;
-			len = strlen(buf);
-			if (buf[len - 1] == '\n') buf[len - 1] = 0;
-				lcd_writechars(&lcd, buf);
-		}
+
+	if (!use_daemon) {
+		/* Before init, so the init sequence is timed as well */
+		if (rt_enable(opt_prio, opt_cpu))
+			return 1;
+
+		lcd_init(&lcd, geo);
+		lcd_contrast(lcd_bias_value);
+
+		/* Poll the busy flag rather than waiting worst case execution
+		 * times.  This requires the LCD WR pin to be wired. */
+		if (busy_poll && atoi(busy_poll))
+			lcd_enable_busy_poll(&lcd);
 	}
-	return 0;
+
+	if (opt_daemon) {
+		c = run_daemon(&lcd, sockpath);
+		if (opt_verbose)
+			print_glyph_stats(&lcd);
+		return c;
+	}
+
+	if (opt_marquee) {
+		c = run_marquee(&lcd, opt_marquee, argc, argv, opt_verbose);
+		if (opt_verbose)
+			print_glyph_stats(&lcd);
+		return c;
+	}
+
+	if (argc >= 1) {
+		for (row = 0; row < argc && row < geo->rows; row++)
+			lcd_update_row(&lcd, row, argv[row], strlen(argv[row]));
+		if (opt_verbose)
+			print_glyph_stats(&lcd);
+		return 0;
+	}
+	c = run_stream(use_daemon ? NULL : &lcd, geo, sockpath, opt_rate,
+	  opt_verbose);
+	if (opt_verbose && !use_daemon)
+		print_glyph_stats(&lcd);
+	return c;
 }
@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "hd44780.h"
+#include "lcdsock.h"
+
+const char *lcdsock_path(void)
+{
+	const char *path = getenv("LCDMESG_SOCKET");
+
+	return path ? path : LCDSOCK_PATH;
+}
+
+static int lcdsock_addr(const char *path, struct sockaddr_un *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(addr->sun_path, path);
+
+	return 0;
+}
+
+int lcdsock_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (lcdsock_addr(path, &addr))
+		return -1;
+
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+		return -1;
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int lcdsock_send(const char *path, const char *msg, size_t len)
+{
+	struct sockaddr_un addr;
+	ssize_t ret;
+	int fd;
+
+	if (lcdsock_addr(path, &addr))
+		return -1;
+
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+		return -1;
+
+	ret = sendto(fd, msg, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+	close(fd);
+
+	return (ret == len) ? 0 : -1;
+}
+
+int lcdsock_next(const char **msg, const char *end, int *row,
+  const char **text, size_t *len)
+{
+	const char *eol, *colon;
+
+	while (*msg < end) {
+		eol = memchr(*msg, '\n', end - *msg);
+		if (!eol)
+			eol = end;
+
+		/* Record is "<row>:<text>" */
+		colon = memchr(*msg, ':', eol - *msg);
+		if (colon && colon > *msg) {
+			*row = atoi(*msg);
+			*text = colon + 1;
+			*len = eol - *text;
+			*msg = eol + 1;
+			return 1;
+		}
+
+		*msg = eol + 1;
+	}
+
+	return 0;
+}
+
+int lcdsock_apply(struct hd44780 *lcd, const char *msg, size_t len)
+{
+	const char *end = msg + len;
+	const char *text;
+	size_t tlen;
+	int row, writes = 0;
+
+	while (lcdsock_next(&msg, end, &row, &text, &tlen)) {
+		if (row >= 0 && row < lcd->geo->rows)
+			writes += lcd_update_row(lcd, row, text, tlen);
+	}
+
+	return writes;
+}
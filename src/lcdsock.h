@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __LCDSOCK_H__
+#define __LCDSOCK_H__
+
+#include <stddef.h>
+#include "hd44780.h"
+
+/* Display updates are sent to a running lcdmesg daemon as datagrams on a
+ * Unix socket, so each update arrives whole no matter how many clients
+ * there are.  A datagram holds one or more newline separated records of
+ * the form "<row>:<text>", e.g. "0:Hello\n1:World".
+ */
+#define LCDSOCK_PATH		"/run/lcdmesg.sock"
+#define LCDSOCK_MSG_MAX		1024
+
+/* Returns the socket path from LCDMESG_SOCKET, or the default */
+const char *lcdsock_path(void);
+
+/* Create and bind the daemon socket, replacing any stale one.
+ * Returns the fd, or -1 with errno set. */
+int lcdsock_listen(const char *path);
+
+/* Send one datagram to the daemon.  Returns 0 on success, or -1 if no
+ * daemon is listening on path. */
+int lcdsock_send(const char *path, const char *msg, size_t len);
+
+/* Step through the records of a datagram, skipping malformed ones.
+ * Returns 1 with the next record's row and text, advancing *msg, or 0 at
+ * the end. */
+int lcdsock_next(const char **msg, const char *end, int *row,
+  const char **text, size_t *len);
+
+/* Apply every record in a datagram to the display.  Malformed records and
+ * rows the display does not have are skipped.
+ *
+ * Returns the number of bus writes issued.
+ */
+int lcdsock_apply(struct hd44780 *lcd, const char *msg, size_t len);
+
+#endif //__LCDSOCK_H__
@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* One binary for the board tools, run as the tool named by argv[0].
+ *
+ * Built with --enable-multicall.  Each tool's source is compiled with its
+ * main() renamed to <tool>_main, and the shared modules are linked in once,
+ * so boot and udev scripts that run several tools page in one executable
+ * instead of one per tool.  "ts7100-utils <tool> ..." works as well as a
+ * link named for the tool.
+ */
+
+#include <libgen.h>
+#include <stdio.h>
+#include <string.h>
+
+int tshwctl_main(int argc, char **argv);
+int lcdmesg_main(int argc, char **argv);
+int keypad_main(int argc, char **argv);
+int frontpanel_main(int argc, char **argv);
+int pc104_peekpoke_main(int argc, char **argv);
+
+static const struct {
+	const char *name;
+	int (*main)(int argc, char **argv);
+} tools[] = {
+	{ "tshwctl", tshwctl_main },
+	{ "lcdmesg", lcdmesg_main },
+	{ "keypad", keypad_main },
+	{ "frontpanel", frontpanel_main },
+	{ "pc104_peekpoke", pc104_peekpoke_main },
+};
+
+int main(int argc, char **argv)
+{
+	const char *name = basename(argv[0]);
+	int i;
+
+	if (!strcmp(name, "ts7100-utils") && argc > 1) {
+		argc--;
+		argv++;
+		name = basename(argv[0]);
+	}
+
+	for (i = 0; i < sizeof(tools)/sizeof(tools[0]); i++)
+		if (!strcmp(name, tools[i].name))
+			return tools[i].main(argc, argv);
+
+	fprintf(stderr, "Usage: ts7100-utils <tool> [OPTIONS]\n"
+	  "Tools, also run by a link of the same name:\n");
+	for (i = 0; i < sizeof(tools)/sizeof(tools[0]); i++)
+		fprintf(stderr, "  %s\n", tools[i].name);
+
+	return 1;
+}
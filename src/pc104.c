@@ -13,183 +13,280 @@
 #include <fcntl.h>
 
 #include "pc104.h"
-#define ISA_PATH "/sys/bus/platform/devices/50004050.fpgaisa/"
-
-static int io8fd;
-static int io16fd;
-static int io16altfd;
-static int mem8fd;
-static int mem16fd;
-static int mem16altfd;
-static ssize_t bus_space_sz = 0x200000;
-static uint8_t *bus_space;
+#include "stats.h"
+#define ISA_PATH "/sys/bus/platform/devices/50004050.fpgaisa"
+
+/* Each node is opened on its first access, most callers only use one */
+static int io8fd = -1;
+static int io16fd = -1;
+static int io16altfd = -1;
+static int mem8fd = -1;
+static int mem16fd = -1;
+static int mem16altfd = -1;
+static char isa_dir[256];
+static int pc104_ready;
+
+static int pc104_open(int *fd, const char *name)
+{
+	char path[sizeof(isa_dir) + 16];
+
+	if (*fd != -1)
+		return *fd;
+
+	assert(pc104_ready);
+	snprintf(path, sizeof(path), "%s/%s", isa_dir, name);
+	*fd = open(path, O_RDWR|O_SYNC);
+	assert(*fd != -1);
+	stats_inc(STATS_SYSCALLS);
+
+	return *fd;
+}
+
+void pc104_init_path(const char *dir)
+{
+	snprintf(isa_dir, sizeof(isa_dir), "%s", dir);
+	pc104_ready = 1;
+}
 
 void pc104_init(void)
 {
-	io8fd = open(ISA_PATH "io8", O_RDWR|O_SYNC);
-	assert(io8fd != -1);
-	io16fd = open(ISA_PATH "io16", O_RDWR|O_SYNC);
-	assert(io16fd != -1);
-	io16altfd = open(ISA_PATH "ioalt16", O_RDWR|O_SYNC);
-	assert(io16altfd != -1);
-	mem8fd = open(ISA_PATH "mem8", O_RDWR|O_SYNC);
-	assert(mem8fd != -1);
-	mem16fd = open(ISA_PATH "mem16", O_RDWR|O_SYNC);
-	assert(mem16fd != -1);
-	mem16altfd = open(ISA_PATH "memalt16", O_RDWR|O_SYNC);
-	assert(mem16altfd != -1);
+	const char *dir;
+
+	if (pc104_ready)
+		return;
+
+	dir = getenv("PC104_ISA_PATH");
+	pc104_init_path(dir && *dir ? dir : ISA_PATH);
 }
 
 uint8_t pc104_io_8_read(uint32_t addr)
 {
 	uint8_t val;
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(io8fd, addr, SEEK_SET);
+	fd = pc104_open(&io8fd, "io8");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = read(io8fd, &val, 1);
+	ret = read(fd, &val, 1);
 	assert(ret == 1);
 
+	stats_end(STATS_PC104_IO_8_READ, &m);
+	stats_add(STATS_SYSCALLS, 2);
+
 	return val;
 }
 
 void pc104_io_8_write(uint32_t addr, uint8_t val)
 {
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(io8fd, addr, SEEK_SET);
+	fd = pc104_open(&io8fd, "io8");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = write(io8fd, &val, 1);
+	ret = write(fd, &val, 1);
 	assert(ret == 1);
+
+	stats_end(STATS_PC104_IO_8_WRITE, &m);
+	stats_add(STATS_SYSCALLS, 2);
 }
 
 uint16_t pc104_io_16_read(uint32_t addr)
 {
 	uint16_t val;
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(io16fd, addr, SEEK_SET);
+	fd = pc104_open(&io16fd, "io16");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = read(io16fd, &val, 2);
+	ret = read(fd, &val, 2);
 	assert(ret == 2);
 
+	stats_end(STATS_PC104_IO_16_READ, &m);
+	stats_add(STATS_SYSCALLS, 2);
+
 	return val;
 }
 
 void pc104_io_16_write(uint32_t addr, uint16_t val)
 {
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(io16fd, addr, SEEK_SET);
+	fd = pc104_open(&io16fd, "io16");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = write(io16fd, &val, 2);
+	ret = write(fd, &val, 2);
 	assert(ret == 2);
+
+	stats_end(STATS_PC104_IO_16_WRITE, &m);
+	stats_add(STATS_SYSCALLS, 2);
 }
 
 uint16_t pc104_io_16_alt_read(uint32_t addr)
 {
 	uint16_t val;
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(io16altfd, addr, SEEK_SET);
+	fd = pc104_open(&io16altfd, "ioalt16");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = read(io16altfd, &val, 2);
+	ret = read(fd, &val, 2);
 	assert(ret == 2);
 
+	stats_end(STATS_PC104_IO_16_ALT_READ, &m);
+	stats_add(STATS_SYSCALLS, 2);
+
 	return val;
 }
 
 void pc104_io_16_alt_write(uint32_t addr, uint16_t val)
 {
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(io16altfd, addr, SEEK_SET);
+	fd = pc104_open(&io16altfd, "ioalt16");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = write(io16altfd, &val, 2);
+	ret = write(fd, &val, 2);
 	assert(ret == 2);
+
+	stats_end(STATS_PC104_IO_16_ALT_WRITE, &m);
+	stats_add(STATS_SYSCALLS, 2);
 }
 
 uint8_t pc104_mem_8_read(uint32_t addr)
 {
 	uint8_t val;
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(mem8fd, addr, SEEK_SET);
+	fd = pc104_open(&mem8fd, "mem8");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = read(mem8fd, &val, 1);
+	ret = read(fd, &val, 1);
 	assert(ret == 1);
 
+	stats_end(STATS_PC104_MEM_8_READ, &m);
+	stats_add(STATS_SYSCALLS, 2);
+
 	return val;
 }
 
 void pc104_mem_8_write(uint32_t addr, uint8_t val)
 {
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(mem8fd, addr, SEEK_SET);
+	fd = pc104_open(&mem8fd, "mem8");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = write(mem8fd, &val, 1);
+	ret = write(fd, &val, 1);
 	assert(ret == 1);
+
+	stats_end(STATS_PC104_MEM_8_WRITE, &m);
+	stats_add(STATS_SYSCALLS, 2);
 }
 
 uint16_t pc104_mem_16_read(uint32_t addr)
 {
 	uint16_t val;
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(mem16fd, addr, SEEK_SET);
+	fd = pc104_open(&mem16fd, "mem16");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = read(mem16fd, &val, 2);
+	ret = read(fd, &val, 2);
 	assert(ret == 2);
 
+	stats_end(STATS_PC104_MEM_16_READ, &m);
+	stats_add(STATS_SYSCALLS, 2);
+
 	return val;
 }
 
 void pc104_mem_16_write(uint32_t addr, uint16_t val)
 {
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(mem16fd, addr, SEEK_SET);
+	fd = pc104_open(&mem16fd, "mem16");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = write(mem16fd, &val, 2);
+	ret = write(fd, &val, 2);
 	assert(ret == 2);
+
+	stats_end(STATS_PC104_MEM_16_WRITE, &m);
+	stats_add(STATS_SYSCALLS, 2);
 }
 
 uint16_t pc104_mem_16_alt_read(uint32_t addr)
 {
 	uint16_t val;
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(mem16altfd, addr, SEEK_SET);
+	fd = pc104_open(&mem16altfd, "memalt16");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = read(mem16altfd, &val, 2);
+	ret = read(fd, &val, 2);
 	assert(ret == 2);
 
+	stats_end(STATS_PC104_MEM_16_ALT_READ, &m);
+	stats_add(STATS_SYSCALLS, 2);
+
 	return val;
 }
 
 void pc104_mem_16_alt_write(uint32_t addr, uint16_t val)
 {
-	int ret;
+	struct stats_mark m;
+	int fd, ret;
 
-	ret = lseek(mem16altfd, addr, SEEK_SET);
+	fd = pc104_open(&mem16altfd, "memalt16");
+	stats_begin(&m);
+	ret = lseek(fd, addr, SEEK_SET);
 	assert(ret != -1);
 
-	ret = write(mem16altfd, &val, 2);
+	ret = write(fd, &val, 2);
 	assert(ret == 2);
+
+	stats_end(STATS_PC104_MEM_16_ALT_WRITE, &m);
+	stats_add(STATS_SYSCALLS, 2);
 }
 
+/* The fault handler decodes ARM instructions, elsewhere only the file
+ * accessors are available */
+#ifdef __arm__
+static ssize_t bus_space_sz = 0x200000;
+static uint8_t *bus_space;
+
 static inline void set_reg(ucontext_t *ctx, uint8_t rd, uint32_t val) {
 	switch (rd & 0xf) {
 	case 0: ctx->uc_mcontext.arm_r0 = val; break;
@@ -314,3 +411,9 @@ void *pc104_mmap_init() {
 	}
 	return bus_space;
 }
+#else
+void *pc104_mmap_init() {
+	fprintf(stderr, "PC104 mmap access is only supported on ARM\n");
+	return NULL;
+}
+#endif
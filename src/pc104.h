@@ -13,9 +13,17 @@
  */
 void *pc104_mmap_init();
 
-/* This must be run before any of the below pc104 calls */
+/* This must be run before any of the below pc104 calls.  The bus nodes
+ * are used from $PC104_ISA_PATH when that is set, for example a pc104emu
+ * mount, otherwise from the fpgaisa sysfs directory.  Each node is only
+ * opened by the first access through it. */
 void pc104_init(void);
 
+/* As pc104_init(), but with the io8, io16, ... nodes in another directory,
+ * for example files on a tmpfs standing in for the bus.  A later
+ * pc104_init(), including the one in pc104_mmap_init(), keeps these. */
+void pc104_init_path(const char *dir);
+
 /* These all directly access the kernel driver to create 8,
  * 16-bit, and alt 16-bit accesses to the PC104 bus.
  *
@@ -0,0 +1,492 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Register-level models of common PC/104 peripherals behind one bus.
+ *
+ * These are close enough to the real parts for driver and acquisition code
+ * to run unchanged against them, not cycle accurate.  Every access is a
+ * single bus cycle: an 8-bit part on a 16-bit cycle sees two byte cycles,
+ * low address first, as it would behind the FPGA bus bridge.
+ *
+ *   8255	Programmable peripheral interface, mode 0 only.  Ports set as
+ *		inputs read as pulled up, outputs read back their latch.
+ *   16550	UART register file with 16 byte FIFOs.  Transmitted bytes are
+ *		dropped unless MCR loopback is set, then they are received.
+ *   adc	16-bit ADC with a 1024 sample FIFO filled in real time, by
+ *		default at 10000 samples per second.  See the register list
+ *		below; each sample is (channel << 12) | (sequence & 0xfff) so
+ *		that acquisition code can check for lost samples.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pc104_models.h"
+
+/* 8255 */
+
+struct ppi8255 {
+	uint8_t ctrl;
+	uint8_t latch[3];
+};
+
+static void *ppi_create(const char *param)
+{
+	struct ppi8255 *p = calloc(1, sizeof(*p));
+
+	/* Reset state, mode 0 with every port an input */
+	if (p)
+		p->ctrl = 0x9b;
+	return p;
+}
+
+/* Bits of port reg that are inputs */
+static uint8_t ppi_inputs(struct ppi8255 *p, uint32_t reg)
+{
+	switch (reg) {
+	case 0:
+		return p->ctrl & 0x10 ? 0xff : 0;
+	case 1:
+		return p->ctrl & 0x02 ? 0xff : 0;
+	default:
+		return (p->ctrl & 0x08 ? 0xf0 : 0) | (p->ctrl & 0x01 ? 0x0f : 0);
+	}
+}
+
+static uint16_t ppi_read(void *st, uint32_t reg, int width)
+{
+	struct ppi8255 *p = st;
+
+	if (reg == 3)
+		return p->ctrl;
+	return ppi_inputs(p, reg) | (p->latch[reg] & ~ppi_inputs(p, reg));
+}
+
+static void ppi_write(void *st, uint32_t reg, uint16_t val, int width)
+{
+	struct ppi8255 *p = st;
+
+	if (reg < 3) {
+		p->latch[reg] = val;
+	} else if (val & 0x80) {
+		/* A mode set clears every output */
+		p->ctrl = val;
+		memset(p->latch, 0, sizeof(p->latch));
+	} else {
+		/* Port C bit set/reset */
+		if (val & 1)
+			p->latch[2] |= 1 << ((val >> 1) & 7);
+		else
+			p->latch[2] &= ~(1 << ((val >> 1) & 7));
+	}
+}
+
+/* 16550 */
+
+#define UART_FIFO	16
+
+struct uart16550 {
+	uint8_t ier, fcr, lcr, mcr, scr, lsr_err;
+	uint16_t divisor;
+	uint8_t rx[UART_FIFO];
+	int rx_head, rx_count;
+	unsigned long tx_bytes;
+};
+
+static void *uart_create(const char *param)
+{
+	return calloc(1, sizeof(struct uart16550));
+}
+
+static uint16_t uart_read(void *st, uint32_t reg, int width)
+{
+	struct uart16550 *u = st;
+	int dlab = u->lcr & 0x80;
+	uint8_t val;
+
+	switch (reg) {
+	case 0:
+		if (dlab)
+			return u->divisor & 0xff;
+		if (!u->rx_count)
+			return 0;
+		val = u->rx[u->rx_head];
+		u->rx_head = (u->rx_head + 1) % UART_FIFO;
+		u->rx_count--;
+		return val;
+	case 1:
+		return dlab ? u->divisor >> 8 : u->ier;
+	case 2:
+		val = u->fcr & 1 ? 0xc0 : 0;
+		if ((u->ier & 0x01) && u->rx_count)
+			return val | 0x04;
+		if (u->ier & 0x02)
+			return val | 0x02;
+		return val | 0x01;
+	case 3:
+		return u->lcr;
+	case 4:
+		return u->mcr;
+	case 5:
+		/* The transmitter is always empty, errors clear on read */
+		val = 0x60 | u->lsr_err | (u->rx_count ? 0x01 : 0);
+		u->lsr_err = 0;
+		return val;
+	case 6:
+		/* In loopback the modem inputs follow the modem outputs */
+		if (!(u->mcr & 0x10))
+			return 0;
+		return ((u->mcr & 0x02) << 3) | ((u->mcr & 0x01) << 5) |
+		  ((u->mcr & 0x04) << 4) | ((u->mcr & 0x08) << 4);
+	default:
+		return u->scr;
+	}
+}
+
+static void uart_write(void *st, uint32_t reg, uint16_t val, int width)
+{
+	struct uart16550 *u = st;
+	int dlab = u->lcr & 0x80;
+	int depth = u->fcr & 1 ? UART_FIFO : 1;
+
+	switch (reg) {
+	case 0:
+		if (dlab) {
+			u->divisor = (u->divisor & 0xff00) | val;
+			break;
+		}
+		u->tx_bytes++;
+		if (!(u->mcr & 0x10))
+			break;
+		if (u->rx_count == depth) {
+			u->lsr_err |= 0x02;	/* Overrun */
+			break;
+		}
+		u->rx[(u->rx_head + u->rx_count) % UART_FIFO] = val;
+		u->rx_count++;
+		break;
+	case 1:
+		if (dlab)
+			u->divisor = (u->divisor & 0xff) | (val << 8);
+		else
+			u->ier = val & 0x0f;
+		break;
+	case 2:
+		if (val & 0x02 || (val & 1) != (u->fcr & 1))
+			u->rx_count = 0;
+		u->fcr = val & 0xc9;
+		break;
+	case 3:
+		u->lcr = val;
+		break;
+	case 4:
+		u->mcr = val & 0x1f;
+		break;
+	case 7:
+		u->scr = val;
+		break;
+	}
+}
+
+/* ADC
+ *
+ *   +0	DATA	Read pops the oldest sample, 0 when empty.  A byte read of
+ *		the low half pops and latches the high half for +1.
+ *   +2	STATUS	Bits 10:0 samples in the FIFO, 14 overflow (cleared on
+ *		read), 15 running.
+ *   +4	CTRL	Bit 0 run, bit 1 empty the FIFO, bits 7:4 last channel
+ *		of the scan.
+ */
+
+#define ADC_FIFO	1024
+
+struct adc {
+	uint16_t ctrl;
+	uint16_t fifo[ADC_FIFO];
+	int head, count, overflow;
+	uint8_t latch;
+	unsigned int channel;
+	uint32_t seq;
+	uint64_t rate;
+	uint64_t start_ns, produced;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *adc_create(const char *param)
+{
+	struct adc *a = calloc(1, sizeof(*a));
+
+	if (a == NULL)
+		return NULL;
+	a->rate = param ? strtoull(param, NULL, 0) : 10000;
+	if (a->rate == 0 || a->rate > 10000000) {
+		fprintf(stderr, "adc: sample rate must be 1 to 10000000\n");
+		free(a);
+		return NULL;
+	}
+	return a;
+}
+
+/* Add every sample converted since the last access.  Samples that do not
+ * fit are skipped over in one step, so an access after a long idle time
+ * costs no more than one that fills the FIFO. */
+static void adc_fill(struct adc *a)
+{
+	uint64_t elapsed, due, lost;
+	unsigned int nch = (a->ctrl >> 4 & 0xf) + 1;
+
+	if (!(a->ctrl & 1))
+		return;
+
+	/* Split so that elapsed * rate cannot overflow */
+	elapsed = now_ns() - a->start_ns;
+	due = elapsed / 1000000000ULL * a->rate +
+	  elapsed % 1000000000ULL * a->rate / 1000000000ULL;
+
+	for (; a->produced < due && a->count < ADC_FIFO; a->produced++) {
+		a->fifo[(a->head + a->count) % ADC_FIFO] =
+		  (a->channel << 12) | (a->seq++ & 0xfff);
+		a->count++;
+		a->channel = (a->channel + 1) % nch;
+	}
+
+	/* Lost samples still count in the sequence */
+	if (a->produced < due) {
+		lost = due - a->produced;
+		a->overflow = 1;
+		a->seq += lost;
+		a->channel = (a->channel + lost) % nch;
+		a->produced = due;
+	}
+}
+
+static uint16_t adc_read16(struct adc *a, uint32_t reg)
+{
+	uint16_t val;
+
+	adc_fill(a);
+	switch (reg) {
+	case 0:
+		if (!a->count)
+			return 0;
+		val = a->fifo[a->head];
+		a->head = (a->head + 1) % ADC_FIFO;
+		a->count--;
+		return val;
+	case 2:
+		val = a->count | (a->overflow << 14) | ((a->ctrl & 1) << 15);
+		a->overflow = 0;
+		return val;
+	case 4:
+		return a->ctrl;
+	default:
+		return 0;
+	}
+}
+
+static uint16_t adc_read(void *st, uint32_t reg, int width)
+{
+	struct adc *a = st;
+	uint16_t val;
+
+	if (width == 2)
+		return adc_read16(a, reg);
+	if (reg == 1)
+		return a->latch;
+
+	val = adc_read16(a, reg & ~1);
+	if (reg == 0)
+		a->latch = val >> 8;
+	return reg & 1 ? val >> 8 : val & 0xff;
+}
+
+static void adc_write(void *st, uint32_t reg, uint16_t val, int width)
+{
+	struct adc *a = st;
+
+	/* Only the low byte of CTRL holds anything */
+	if (reg != 4)
+		return;
+
+	adc_fill(a);
+	if (val & 2) {
+		a->count = 0;
+		a->overflow = 0;
+	}
+	if ((val & 1) && !(a->ctrl & 1)) {
+		a->start_ns = now_ns();
+		a->produced = 0;
+		a->channel = 0;
+	}
+	a->ctrl = val & 0xf1;
+}
+
+static const struct pc104_model ppi8255_model = {
+	"8255", "PPI, ports A, B, C and control", 4, 0,
+	ppi_create, ppi_read, ppi_write,
+};
+
+static const struct pc104_model uart16550_model = {
+	"16550", "UART register file", 8, 0,
+	uart_create, uart_read, uart_write,
+};
+
+static const struct pc104_model adc_model = {
+	"adc", "ADC with sample FIFO, :rate in Hz", 8, 1,
+	adc_create, adc_read, adc_write,
+};
+
+const struct pc104_model * const pc104_models[] = {
+	&ppi8255_model,
+	&uart16550_model,
+	&adc_model,
+	NULL,
+};
+
+int pc104_bus_init(struct pc104_bus *bus)
+{
+	memset(bus, 0, sizeof(*bus));
+	bus->mem = calloc(1, PC104_SPACE_SIZE);
+	if (bus->mem == NULL) {
+		perror("pc104 bus");
+		return -1;
+	}
+	return 0;
+}
+
+int pc104_bus_add(struct pc104_bus *bus, const char *spec)
+{
+	const struct pc104_model *m = NULL;
+	struct pc104_dev *d;
+	const char *at;
+	char *end;
+	int i;
+
+	if (bus->ndevs == PC104_MAX_DEVS) {
+		fprintf(stderr, "At most %d devices\n", PC104_MAX_DEVS);
+		return -1;
+	}
+	d = &bus->devs[bus->ndevs];
+
+	at = strchr(spec, '@');
+	for (i = 0; at && pc104_models[i]; i++) {
+		if (strlen(pc104_models[i]->type) == at - spec &&
+		  !strncmp(pc104_models[i]->type, spec, at - spec))
+			m = pc104_models[i];
+	}
+	if (m == NULL) {
+		fprintf(stderr, "Bad device \"%s\", expected type@addr\n", spec);
+		return -1;
+	}
+
+	d->model = m;
+	d->space = PC104_IO;
+	at++;
+	if (!strncmp(at, "mem:", 4)) {
+		d->space = PC104_MEM;
+		at += 4;
+	}
+	d->base = strtoul(at, &end, 0);
+	if (end == at || (*end && *end != ':') ||
+	  d->base + m->size > PC104_SPACE_SIZE || (m->is16 && d->base & 1)) {
+		fprintf(stderr, "Bad address in \"%s\"\n", spec);
+		return -1;
+	}
+
+	for (i = 0; i < bus->ndevs; i++) {
+		struct pc104_dev *o = &bus->devs[i];
+
+		if (o->space == d->space && d->base < o->base + o->model->size &&
+		  o->base < d->base + m->size) {
+			fprintf(stderr, "\"%s\" overlaps a %s at 0x%X\n", spec,
+			  o->model->type, o->base);
+			return -1;
+		}
+	}
+
+	d->st = m->create(*end ? end + 1 : NULL);
+	if (d->st == NULL)
+		return -1;
+	bus->ndevs++;
+
+	return 0;
+}
+
+static struct pc104_dev *pc104_decode(struct pc104_bus *bus,
+  enum pc104_space space, uint32_t addr)
+{
+	int i;
+
+	for (i = 0; i < bus->ndevs; i++) {
+		struct pc104_dev *d = &bus->devs[i];
+
+		if (d->space == space && addr - d->base < d->model->size)
+			return d;
+	}
+	return NULL;
+}
+
+static uint8_t pc104_read8(struct pc104_bus *bus, enum pc104_space space,
+  uint32_t addr)
+{
+	struct pc104_dev *d = pc104_decode(bus, space, addr);
+
+	if (d)
+		return d->model->read(d->st, addr - d->base, 1);
+	return space == PC104_MEM ? bus->mem[addr] : 0xff;
+}
+
+static void pc104_write8(struct pc104_bus *bus, enum pc104_space space,
+  uint32_t addr, uint8_t val)
+{
+	struct pc104_dev *d = pc104_decode(bus, space, addr);
+
+	if (d)
+		d->model->write(d->st, addr - d->base, val, 1);
+	else if (space == PC104_MEM)
+		bus->mem[addr] = val;
+}
+
+uint16_t pc104_bus_read(struct pc104_bus *bus, enum pc104_space space,
+  uint32_t addr, int width)
+{
+	struct pc104_dev *d;
+
+	bus->reads[space]++;
+	if (width == 1)
+		return pc104_read8(bus, space, addr);
+
+	d = pc104_decode(bus, space, addr);
+	if (d && d->model->is16)
+		return d->model->read(d->st, addr - d->base, 2);
+	return pc104_read8(bus, space, addr) |
+	  pc104_read8(bus, space, addr + 1) << 8;
+}
+
+void pc104_bus_write(struct pc104_bus *bus, enum pc104_space space,
+  uint32_t addr, uint16_t val, int width)
+{
+	struct pc104_dev *d;
+
+	bus->writes[space]++;
+	if (width == 1) {
+		pc104_write8(bus, space, addr, val);
+		return;
+	}
+
+	d = pc104_decode(bus, space, addr);
+	if (d && d->model->is16) {
+		d->model->write(d->st, addr - d->base, val, 2);
+		return;
+	}
+	pc104_write8(bus, space, addr, val & 0xff);
+	pc104_write8(bus, space, addr + 1, val >> 8);
+}
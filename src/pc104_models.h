@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __PC104_MODELS_H__
+#define __PC104_MODELS_H__
+
+#include <stdint.h>
+
+#define PC104_SPACE_SIZE	0x100000
+#define PC104_MAX_DEVS		16
+
+enum pc104_space {
+	PC104_IO,
+	PC104_MEM,
+};
+
+struct pc104_model {
+	const char *type;
+	const char *desc;
+	uint32_t size;		/* Bytes of address space decoded */
+	int is16;		/* Registers are 16 bits wide */
+	/* param is the text after ':' in the device spec, or NULL */
+	void *(*create)(const char *param);
+	/* reg is the offset from the base.  8-bit models only ever see
+	 * width 1, a 16-bit cycle is split into two byte cycles. */
+	uint16_t (*read)(void *st, uint32_t reg, int width);
+	void (*write)(void *st, uint32_t reg, uint16_t val, int width);
+};
+
+struct pc104_dev {
+	const struct pc104_model *model;
+	enum pc104_space space;
+	uint32_t base;
+	void *st;
+};
+
+struct pc104_bus {
+	struct pc104_dev devs[PC104_MAX_DEVS];
+	int ndevs;
+	uint8_t *mem;		/* Backs every MEM address no device decodes */
+	unsigned long reads[2];
+	unsigned long writes[2];
+};
+
+extern const struct pc104_model * const pc104_models[];
+
+/* Returns 0, or -1 with an error printed. */
+int pc104_bus_init(struct pc104_bus *bus);
+
+/* Add a device from a spec of the form type@addr[:param], such as
+ * "16550@0x3f8" or "adc@0x160:20000".  "mem:" in front of the address
+ * places the device in MEM space.  Returns 0, or -1 with an error
+ * printed. */
+int pc104_bus_add(struct pc104_bus *bus, const char *spec);
+
+/* One bus cycle of width 1 or 2 bytes.  16-bit cycles must be on even
+ * addresses.  IO addresses no device decodes read as all ones. */
+uint16_t pc104_bus_read(struct pc104_bus *bus, enum pc104_space space,
+  uint32_t addr, int width);
+void pc104_bus_write(struct pc104_bus *bus, enum pc104_space space,
+  uint32_t addr, uint16_t val, int width);
+
+#endif //__PC104_MODELS_H__
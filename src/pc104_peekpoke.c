@@ -9,10 +9,11 @@
 
 #include "pc104.h"
 #include "helpers.h"
+#include "stats.h"
 
-void usage(char *name)
+static void usage(char *name)
 {
-	fprintf(stderr, "Usage %s <io/mem> <8/16/alt16> <address> [value]\n", name);
+	fprintf(stderr, "Usage %s [--stats] <io/mem> <8/16/alt16> <address> [value]\n", name);
 	fprintf(stderr, "\tEg: %s io 8 0x140\n", name);
 }
 
@@ -21,7 +22,10 @@ int main(int argc, char **argv) {
 	uint32_t off, val;
 	int is_io = 0;
 
-	if(get_model() != 0x7250) {
+	stats_init(&argc, argv);
+
+	/* An emulated bus, see pc104emu, works on any host */
+	if(!getenv("PC104_ISA_PATH") && get_model() != 0x7250) {
 		fprintf(stderr, "Only supported on the TS-7250-V3\n");
 		return 1;
 	}
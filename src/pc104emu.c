@@ -0,0 +1,278 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Emulated PC/104 bus served over FUSE.
+ *
+ * The mount holds the same io8, io16, ioalt16, mem8, mem16 and memalt16
+ * nodes as the fpgaisa sysfs directory, and each read or write at an
+ * offset becomes bus cycles on the peripheral models in pc104_models.c.
+ * Point pc104.c at it with PC104_ISA_PATH to run pc104_peekpoke or
+ * acquisition code on any Linux host:
+ *
+ *   pc104emu --dev=adc@0x160:50000 /tmp/isa
+ *   PC104_ISA_PATH=/tmp/isa pc104_peekpoke io 16 0x162
+ *
+ * The alt16 nodes carry the same cycles as the 16-bit ones, the alternate
+ * pinout only moves which header pins are used.  Every file is opened
+ * direct_io so that no access is served from the page cache.
+ */
+
+#define FUSE_USE_VERSION 31
+
+#include <errno.h>
+#include <fuse.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "pc104_models.h"
+
+struct emu_node {
+	const char *name;
+	enum pc104_space space;
+	int width;
+};
+
+static const struct emu_node emu_nodes[] = {
+	{ "io8", PC104_IO, 1 },
+	{ "io16", PC104_IO, 2 },
+	{ "ioalt16", PC104_IO, 2 },
+	{ "mem8", PC104_MEM, 1 },
+	{ "mem16", PC104_MEM, 2 },
+	{ "memalt16", PC104_MEM, 2 },
+};
+
+#define NNODES (sizeof(emu_nodes)/sizeof(emu_nodes[0]))
+
+/* FUSE serves requests from several threads, the bus is one at a time */
+static pthread_mutex_t bus_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pc104_bus bus;
+
+static const struct emu_node *emu_lookup(const char *path)
+{
+	int i;
+
+	for (i = 0; i < NNODES; i++)
+		if (path[0] == '/' && !strcmp(path + 1, emu_nodes[i].name))
+			return &emu_nodes[i];
+	return NULL;
+}
+
+static void *emu_init(struct fuse_conn_info *conn, struct fuse_config *cfg)
+{
+	cfg->direct_io = 1;
+	cfg->kernel_cache = 0;
+	return NULL;
+}
+
+static void emu_destroy(void *data)
+{
+	fprintf(stderr, "io_reads=%lu io_writes=%lu mem_reads=%lu "
+	  "mem_writes=%lu\n", bus.reads[PC104_IO], bus.writes[PC104_IO],
+	  bus.reads[PC104_MEM], bus.writes[PC104_MEM]);
+}
+
+static int emu_getattr(const char *path, struct stat *st,
+  struct fuse_file_info *fi)
+{
+	memset(st, 0, sizeof(*st));
+	if (!strcmp(path, "/")) {
+		st->st_mode = S_IFDIR | 0755;
+		st->st_nlink = 2;
+		return 0;
+	}
+	if (!emu_lookup(path))
+		return -ENOENT;
+
+	st->st_mode = S_IFREG | 0600;
+	st->st_nlink = 1;
+	st->st_size = PC104_SPACE_SIZE;
+	return 0;
+}
+
+static int emu_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+  off_t off, struct fuse_file_info *fi, enum fuse_readdir_flags flags)
+{
+	int i;
+
+	if (strcmp(path, "/"))
+		return -ENOENT;
+
+	filler(buf, ".", NULL, 0, 0);
+	filler(buf, "..", NULL, 0, 0);
+	for (i = 0; i < NNODES; i++)
+		filler(buf, emu_nodes[i].name, NULL, 0, 0);
+	return 0;
+}
+
+static int emu_open(const char *path, struct fuse_file_info *fi)
+{
+	if (!emu_lookup(path))
+		return -ENOENT;
+	fi->direct_io = 1;
+	return 0;
+}
+
+/* As the sysfs nodes, a transfer is a run of cycles of the node's width
+ * and must be aligned to it */
+static int emu_check(const struct emu_node *n, size_t *size, off_t off)
+{
+	if (off % n->width || *size % n->width)
+		return -EINVAL;
+	if (off >= PC104_SPACE_SIZE)
+		return 0;
+	if (*size > PC104_SPACE_SIZE - off)
+		*size = PC104_SPACE_SIZE - off;
+	return 1;
+}
+
+static int emu_read(const char *path, char *buf, size_t size, off_t off,
+  struct fuse_file_info *fi)
+{
+	const struct emu_node *n = emu_lookup(path);
+	uint16_t val;
+	size_t i;
+	int ret;
+
+	if (n == NULL)
+		return -ENOENT;
+	ret = emu_check(n, &size, off);
+	if (ret < 1)
+		return ret;
+
+	pthread_mutex_lock(&bus_mutex);
+	for (i = 0; i < size; i += n->width) {
+		val = pc104_bus_read(&bus, n->space, off + i, n->width);
+		if (n->width == 1)
+			buf[i] = val;
+		else
+			memcpy(buf + i, &val, 2);
+	}
+	pthread_mutex_unlock(&bus_mutex);
+
+	return size;
+}
+
+static int emu_write(const char *path, const char *buf, size_t size,
+  off_t off, struct fuse_file_info *fi)
+{
+	const struct emu_node *n = emu_lookup(path);
+	uint16_t val;
+	size_t i;
+	int ret;
+
+	if (n == NULL)
+		return -ENOENT;
+	ret = emu_check(n, &size, off);
+	if (ret < 1)
+		return ret ? ret : -ENOSPC;
+
+	pthread_mutex_lock(&bus_mutex);
+	for (i = 0; i < size; i += n->width) {
+		if (n->width == 1)
+			val = (uint8_t)buf[i];
+		else
+			memcpy(&val, buf + i, 2);
+		pc104_bus_write(&bus, n->space, off + i, val, n->width);
+	}
+	pthread_mutex_unlock(&bus_mutex);
+
+	return size;
+}
+
+/* O_TRUNC and the like from shell redirections are accepted and ignored */
+static int emu_truncate(const char *path, off_t size,
+  struct fuse_file_info *fi)
+{
+	return emu_lookup(path) ? 0 : -ENOENT;
+}
+
+static const struct fuse_operations emu_ops = {
+	.init = emu_init,
+	.destroy = emu_destroy,
+	.getattr = emu_getattr,
+	.readdir = emu_readdir,
+	.open = emu_open,
+	.read = emu_read,
+	.write = emu_write,
+	.truncate = emu_truncate,
+};
+
+enum {
+	KEY_DEV,
+	KEY_HELP,
+};
+
+static const struct fuse_opt emu_opts[] = {
+	FUSE_OPT_KEY("--dev=", KEY_DEV),
+	FUSE_OPT_KEY("-h", KEY_HELP),
+	FUSE_OPT_KEY("--help", KEY_HELP),
+	FUSE_OPT_END
+};
+
+static int ndev_opts;
+
+static void usage(const char *name)
+{
+	int i;
+
+	printf("Usage: %s [OPTIONS] <mountpoint>\n"
+	  "Emulated PC/104 bus for PC104_ISA_PATH\n"
+	  "\n"
+	  "  --dev=<type@addr>        Add a device, may be repeated.  The\n"
+	  "                             address may start with mem: and be\n"
+	  "                             followed by :param\n"
+	  "  -h, --help               This message\n"
+	  "\n"
+	  "Without --dev the bus has an 8255@0x100, a 16550@0x3f8 and an\n"
+	  "adc@0x160.  Device types:\n",
+	  name);
+	for (i = 0; pc104_models[i]; i++)
+		printf("  %-25s%s\n", pc104_models[i]->type,
+		  pc104_models[i]->desc);
+	printf("\n");
+}
+
+static int emu_opt(void *data, const char *arg, int key,
+  struct fuse_args *outargs)
+{
+	switch (key) {
+	case KEY_DEV:
+		ndev_opts++;
+		if (pc104_bus_add(&bus, arg + strlen("--dev=")))
+			exit(1);
+		return 0;
+	case KEY_HELP:
+		usage(outargs->argv[0]);
+		/* Kept so that fuse_main() lists its own options and exits,
+		 * an empty program name skips its usage line */
+		outargs->argv[0][0] = '\0';
+		return 1;
+	}
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+	static const char * const defaults[] = {
+		"8255@0x100", "16550@0x3f8", "adc@0x160",
+	};
+	int i, ret;
+
+	if (pc104_bus_init(&bus))
+		return 1;
+	if (fuse_opt_parse(&args, NULL, emu_opts, emu_opt))
+		return 1;
+
+	for (i = 0; !ndev_opts && i < sizeof(defaults)/sizeof(defaults[0]); i++)
+		if (pc104_bus_add(&bus, defaults[i]))
+			return 1;
+
+	ret = fuse_main(args.argc, args.argv, &emu_ops, NULL);
+	fuse_opt_free_args(&args);
+
+	return ret;
+}
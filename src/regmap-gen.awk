@@ -0,0 +1,122 @@
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS
+#
+# Compile regmap.def into a C table with a collision free hash, so a name
+# is resolved with one hash and one string compare.  The hash must match
+# regmap_hash() in regmap.c.  Only POSIX awk arithmetic is used, every
+# intermediate stays well below 2^53 so mawk computes it exactly.
+
+function hex(s,    i, c, v) {
+	v = 0
+	s = tolower(s)
+	sub(/^0x/, "", s)
+	for (i = 1; i <= length(s); i++) {
+		c = index("0123456789abcdef", substr(s, i, 1))
+		if (c == 0)
+			fail("bad hex number " s)
+		v = v * 16 + c - 1
+	}
+	return v
+}
+
+function hash(model, name, mult,    h, i) {
+	h = model % P
+	for (i = 1; i <= length(name); i++)
+		h = (h * mult + index(CHARS, substr(name, i, 1)) + 31) % P
+	return h
+}
+
+# Fill slot[] and return a multiplier that is collision free for a table
+# of size slots, or 0 if there is none
+function search(size,    mult, i, s, ok) {
+	for (mult = 2; mult < 4096; mult++) {
+		split("", slot)
+		ok = 1
+		for (i = 0; i < n && ok; i++) {
+			s = hash(model[i], name[i], mult) % size
+			if (s in slot)
+				ok = 0
+			slot[s] = i
+		}
+		if (ok)
+			return mult
+	}
+	return 0
+}
+
+function fail(msg) {
+	printf("regmap.def:%d: %s\n", NR, msg) > "/dev/stderr"
+	failed = 1
+	exit 1
+}
+
+BEGIN {
+	P = 1048573
+	CHARS = " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~"
+	n = 0
+}
+
+/^#/ || NF == 0 { next }
+
+{
+	if (NF != 5)
+		fail("expected model name offset bits access")
+	if ($2 !~ /^[A-Z0-9_.]+$/ || length($2) >= 32)
+		fail("bad name " $2)
+	if ($5 != "ro" && $5 != "rw")
+		fail("access must be ro or rw")
+
+	model[n] = hex($1)
+	name[n] = $2
+	offs[n] = hex($3)
+	if ($4 ~ /^[0-9]+:[0-9]+$/) {
+		split($4, b, ":")
+		msb[n] = b[1] + 0
+		lsb[n] = b[2] + 0
+	} else if ($4 ~ /^[0-9]+$/) {
+		msb[n] = lsb[n] = $4 + 0
+	} else {
+		fail("bad bits " $4)
+	}
+	if (msb[n] > 31 || lsb[n] > msb[n])
+		fail("bad bits " $4)
+	if (offs[n] % 4)
+		fail("offset must be 32 bit aligned")
+	rw[n] = ($5 == "rw")
+
+	key = model[n] SUBSEP name[n]
+	if (key in seen)
+		fail("duplicate " $2)
+	seen[key] = 1
+	n++
+}
+
+END {
+	if (failed)
+		exit 1
+
+	# Smallest power of two table, then the first multiplier, that puts
+	# no two names in one slot
+	for (size = 1; size < 2 * n; size *= 2);
+	while (!(mult = search(size)))
+		size *= 2
+
+	print "/* Generated from regmap.def by regmap-gen.awk, do not edit */"
+	print ""
+	print "#include \"regmap.h\""
+	print ""
+	printf("const uint32_t regmap_hash_mult = %d;\n", mult)
+	printf("const uint32_t regmap_nslots = %d;\n", size)
+	printf("const int regmap_nentries = %d;\n", n)
+	print ""
+	print "const struct regmap_entry regmap_entries[] = {"
+	for (i = 0; i < n; i++)
+		printf("\t{ 0x%x, \"%s\", 0x%x, %d, %d, %d },\n", model[i],
+		  name[i], offs[i], msb[i], lsb[i], rw[i])
+	print "};"
+	print ""
+	print "const int16_t regmap_slots[] = {"
+	for (s = 0; s < size; s++)
+		printf("\t%d,\n", (s in slot) ? slot[s] : -1)
+	print "};"
+}
@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Named syscon registers and fields.
+ *
+ * The definitions in regmap.def are compiled at build time, so nothing is
+ * parsed at run time.  The generator picks a hash multiplier that gives
+ * every name of every model its own slot, so a lookup is one hash, one
+ * probe and one string compare.
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include "regmap.h"
+
+/* Must match hash() in regmap-gen.awk.  h stays below 2^20 and the
+ * multiplier below 2^12, so nothing overflows 32 bits. */
+#define REGMAP_HASH_PRIME	1048573
+
+static uint32_t regmap_hash(int model, const char *name)
+{
+	uint32_t h = model % REGMAP_HASH_PRIME;
+
+	for (; *name; name++)
+		h = (h * regmap_hash_mult + (uint8_t)*name) %
+		  REGMAP_HASH_PRIME;
+
+	return h;
+}
+
+const struct regmap_entry *regmap_lookup(int model, const char *name)
+{
+	char upper[REGMAP_NAME_MAX];
+	const struct regmap_entry *e;
+	int i, slot;
+
+	for (i = 0; name[i]; i++) {
+		if (i == REGMAP_NAME_MAX - 1)
+			return NULL;
+		upper[i] = toupper((unsigned char)name[i]);
+	}
+	upper[i] = '\0';
+
+	slot = regmap_slots[regmap_hash(model, upper) % regmap_nslots];
+	if (slot < 0)
+		return NULL;
+
+	e = &regmap_entries[slot];
+	if (e->model != model || strcmp(e->name, upper))
+		return NULL;
+
+	return e;
+}
+
+uint32_t regmap_write_mask(int model, uint32_t offs)
+{
+	uint32_t mask = 0;
+	int i;
+
+	for (i = 0; i < regmap_nentries; i++)
+		if (regmap_entries[i].model == model &&
+		  regmap_entries[i].offs == offs && regmap_entries[i].writable)
+			mask |= regmap_mask(&regmap_entries[i]);
+
+	return mask;
+}
+
+void regmap_list(int model, FILE *out)
+{
+	const struct regmap_entry *e;
+	int i;
+
+	for (i = 0; i < regmap_nentries; i++) {
+		e = &regmap_entries[i];
+		if (e->model != model)
+			continue;
+		if (e->msb == e->lsb)
+			fprintf(out, "%s 0x%03X %u %s\n", e->name, e->offs,
+			  e->msb, e->writable ? "rw" : "ro");
+		else
+			fprintf(out, "%s 0x%03X %u:%u %s\n", e->name, e->offs,
+			  e->msb, e->lsb, e->writable ? "rw" : "ro");
+	}
+}
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __REGMAP_H__
+#define __REGMAP_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define REGMAP_NAME_MAX		32
+
+/* A syscon register, or a field REGISTER.FIELD of bits msb to lsb */
+struct regmap_entry {
+	uint16_t model;
+	const char *name;
+	uint16_t offs;
+	uint8_t msb;
+	uint8_t lsb;
+	uint8_t writable;
+};
+
+/* Generated from regmap.def into regmap-table.c */
+extern const uint32_t regmap_hash_mult;
+extern const uint32_t regmap_nslots;
+extern const int regmap_nentries;
+extern const struct regmap_entry regmap_entries[];
+extern const int16_t regmap_slots[];
+
+/* Find a register or field by name, ignoring case, with a single hash
+ * probe.  Returns NULL if the model has no such name. */
+const struct regmap_entry *regmap_lookup(int model, const char *name);
+
+/* The bits an entry covers, in place in the register */
+static inline uint32_t regmap_mask(const struct regmap_entry *e)
+{
+	return (0xffffffffU >> (31 - e->msb)) & (0xffffffffU << e->lsb);
+}
+
+/* Bits of a register that can be written back, the union of its rw
+ * entries, 0 for read-only */
+uint32_t regmap_write_mask(int model, uint32_t offs);
+
+/* Print every entry for this model */
+void regmap_list(int model, FILE *out);
+
+#endif //__REGMAP_H__
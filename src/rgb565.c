@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* RGB888 to big-endian RGB565 conversion.
+ *
+ * The straight and ordered dither conversions use NEON when the compiler
+ * targets it, converting 16 pixels per iteration, with a scalar loop for
+ * the remainder and for other CPUs.  Floyd-Steinberg is inherently serial
+ * along a row and is always scalar.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rgb565.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_NEON 1
+const char *rgb565_kernel = "neon";
+#else
+const char *rgb565_kernel = "scalar";
+#endif
+
+static const uint8_t bayer4[4][4] = {
+	{  0,  8,  2, 10 },
+	{ 12,  4, 14,  6 },
+	{  3, 11,  1,  9 },
+	{ 15,  7, 13,  5 },
+};
+
+static inline uint8_t sat_add(uint8_t a, uint8_t b)
+{
+	return (a + b > 0xff) ? 0xff : a + b;
+}
+
+/* Big-endian output: RRRRRGGG GGGBBBBB */
+static inline void put_pixel(uint8_t *dst, uint8_t r, uint8_t g, uint8_t b)
+{
+	dst[0] = (r & 0xf8) | (g >> 5);
+	dst[1] = ((g & 0x1c) << 3) | (b >> 3);
+}
+
+#ifdef HAVE_NEON
+/* Convert 16 pixels, adding per-channel bias first with saturation */
+static inline void neon_16px(uint8_t *dst, const uint8_t *src,
+  uint8x16_t bias5, uint8x16_t bias6)
+{
+	uint8x16x3_t px = vld3q_u8(src);
+	uint8x16x2_t out;
+	uint8x16_t r, g, b;
+
+	r = vqaddq_u8(px.val[0], bias5);
+	g = vqaddq_u8(px.val[1], bias6);
+	b = vqaddq_u8(px.val[2], bias5);
+
+	out.val[0] = vorrq_u8(vandq_u8(r, vdupq_n_u8(0xf8)), vshrq_n_u8(g, 5));
+	out.val[1] = vorrq_u8(vshlq_n_u8(vandq_u8(g, vdupq_n_u8(0x1c)), 3),
+	  vshrq_n_u8(b, 3));
+	vst2q_u8(dst, out);
+}
+#endif
+
+void rgb565_convert(uint8_t *dst, const uint8_t *src, size_t npix)
+{
+	size_t i = 0;
+
+#ifdef HAVE_NEON
+	uint8x16_t zero = vdupq_n_u8(0);
+
+	for (; i + 16 <= npix; i += 16)
+		neon_16px(dst + i * 2, src + i * 3, zero, zero);
+#endif
+	for (; i < npix; i++)
+		put_pixel(dst + i * 2, src[i * 3], src[i * 3 + 1], src[i * 3 + 2]);
+}
+
+/* Add a threshold from the Bayer matrix scaled to the quantization step of
+ * each channel, 8 for the 5 bit channels and 4 for green, then truncate. */
+static void convert_ordered(uint8_t *dst, const uint8_t *src, int width,
+  int height)
+{
+	uint8_t bias5[16], bias6[16];
+	const uint8_t *s;
+	uint8_t *d;
+	int x, y;
+
+	for (y = 0; y < height; y++) {
+		s = src + (size_t)y * width * 3;
+		d = dst + (size_t)y * width * 2;
+		for (x = 0; x < 16; x++) {
+			bias5[x] = bayer4[y & 3][x & 3] >> 1;
+			bias6[x] = bayer4[y & 3][x & 3] >> 2;
+		}
+
+		x = 0;
+#ifdef HAVE_NEON
+		{
+			uint8x16_t b5 = vld1q_u8(bias5);
+			uint8x16_t b6 = vld1q_u8(bias6);
+
+			for (; x + 16 <= width; x += 16)
+				neon_16px(d + x * 2, s + x * 3, b5, b6);
+		}
+#endif
+		for (; x < width; x++)
+			put_pixel(d + x * 2,
+			  sat_add(s[x * 3], bias5[x & 3]),
+			  sat_add(s[x * 3 + 1], bias6[x & 3]),
+			  sat_add(s[x * 3 + 2], bias5[x & 3]));
+	}
+}
+
+static inline int clamp8(int v)
+{
+	return (v < 0) ? 0 : (v > 0xff) ? 0xff : v;
+}
+
+/* Floyd-Steinberg, diffusing the difference between each input channel and
+ * the value the panel will actually show for it.  Two rows of error are
+ * kept per channel, with a pixel of padding at each end. */
+static int convert_fs(uint8_t *dst, const uint8_t *src, int width,
+  int height)
+{
+	int16_t *err, *cur, *next, *tmp;
+	int x, y, c, v, q, e;
+	uint8_t out[3];
+
+	err = calloc((size_t)(width + 2) * 3 * 2, sizeof(int16_t));
+	if (!err)
+		return -1;
+	cur = err;
+	next = err + (width + 2) * 3;
+
+	for (y = 0; y < height; y++) {
+		memset(next, 0, (width + 2) * 3 * sizeof(int16_t));
+		for (x = 0; x < width; x++) {
+			for (c = 0; c < 3; c++) {
+				int i = (x + 1) * 3 + c;
+
+				v = clamp8(src[((size_t)y * width + x) * 3 + c] +
+				  cur[i] / 16);
+				if (c == 1) {
+					q = v & 0xfc;
+					q |= q >> 6;
+				} else {
+					q = v & 0xf8;
+					q |= q >> 5;
+				}
+				out[c] = v;
+				e = v - q;
+
+				cur[i + 3] += e * 7;
+				next[i - 3] += e * 3;
+				next[i] += e * 5;
+				next[i + 3] += e;
+			}
+			put_pixel(dst + ((size_t)y * width + x) * 2, out[0],
+			  out[1], out[2]);
+		}
+		tmp = cur;
+		cur = next;
+		next = tmp;
+	}
+
+	free(err);
+	return 0;
+}
+
+int rgb565_convert_image(uint8_t *dst, const uint8_t *src, int width,
+  int height, enum rgb565_dither dither)
+{
+	switch (dither) {
+	case RGB565_DITHER_ORDERED:
+		convert_ordered(dst, src, width, height);
+		return 0;
+	case RGB565_DITHER_FS:
+		return convert_fs(dst, src, width, height);
+	default:
+		rgb565_convert(dst, src, (size_t)width * height);
+		return 0;
+	}
+}
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __RGB565_H__
+#define __RGB565_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Pixel conversion from packed RGB888 to RGB565 with big-endian byte
+ * ordering, the format the TS-7100 LCD splash screen is stored in.  src
+ * holds 3 bytes per pixel and dst receives 2.
+ */
+
+enum rgb565_dither {
+	RGB565_DITHER_NONE = 0,
+	RGB565_DITHER_ORDERED,		/* 4x4 Bayer matrix */
+	RGB565_DITHER_FS,		/* Floyd-Steinberg error diffusion */
+};
+
+/* Name of the conversion kernel compiled in, e.g. "neon" or "scalar" */
+extern const char *rgb565_kernel;
+
+static inline uint16_t rgb565_pack(uint8_t r, uint8_t g, uint8_t b)
+{
+	return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+void rgb565_convert(uint8_t *dst, const uint8_t *src, size_t npix);
+
+/* Convert a width x height image with dithering.  Returns 0, or -1 if
+ * memory for error diffusion could not be allocated. */
+int rgb565_convert_image(uint8_t *dst, const uint8_t *src, int width,
+  int height, enum rgb565_dither dither);
+
+#endif //__RGB565_H__
@@ -0,0 +1,169 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Optional real-time execution for the bit-banging tools.
+ *
+ * At normal priority a loaded system can stretch a 10ms keypad scan or an
+ * LCD enable pulse by milliseconds.  Under SCHED_FIFO the process only
+ * yields to higher priority threads, and with its memory locked a page
+ * fault can not add a disk read to a cycle either.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "rt.h"
+#include "stats.h"
+
+#define RT_STACK_PREFAULT	(64 * 1024)
+
+int rt_parse(int opt, const char *arg, int *prio, int *cpu)
+{
+	char *end;
+	long val = strtol(arg, &end, 0);
+
+	if (opt == RT_OPT_PRIO) {
+		if (*end || val < 1 || val > 99) {
+			fprintf(stderr, "Real-time priority must be 1-99\n");
+			return -1;
+		}
+		*prio = val;
+	} else {
+		if (*end || val < 0 || val >= CPU_SETSIZE) {
+			fprintf(stderr, "Invalid CPU \"%s\"\n", arg);
+			return -1;
+		}
+		*cpu = val;
+	}
+
+	return 0;
+}
+
+static void __attribute__((noinline)) rt_prefault_stack(void)
+{
+	volatile char stack[RT_STACK_PREFAULT];
+
+	memset((char *)stack, 0, sizeof(stack));
+}
+
+int rt_enable(int prio, int cpu)
+{
+	struct sched_param sp;
+	cpu_set_t set;
+
+	if (cpu >= 0) {
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set)) {
+			fprintf(stderr, "CPU %d: %s\n", cpu, strerror(errno));
+			return -1;
+		}
+	}
+
+	if (prio == 0)
+		return 0;
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+		fprintf(stderr, "mlockall: %s\n", strerror(errno));
+		return -1;
+	}
+	rt_prefault_stack();
+
+	memset(&sp, 0, sizeof(sp));
+	sp.sched_priority = prio;
+	/* Children, such as commands frontpanel runs, start as SCHED_OTHER */
+	if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &sp)) {
+		fprintf(stderr, "SCHED_FIFO: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+static uint64_t ts_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts_ns(&ts);
+}
+
+static void rt_advance(struct rt_period *p)
+{
+	p->next.tv_nsec += p->period_ns % 1000000000ULL;
+	p->next.tv_sec += p->period_ns / 1000000000ULL;
+	if (p->next.tv_nsec >= 1000000000L) {
+		p->next.tv_nsec -= 1000000000L;
+		p->next.tv_sec++;
+	}
+}
+
+void rt_period_init(struct rt_period *p, uint64_t period_ns)
+{
+	memset(p, 0, sizeof(*p));
+	p->period_ns = period_ns;
+	p->min_ns = UINT64_MAX;
+	clock_gettime(CLOCK_MONOTONIC, &p->next);
+	rt_advance(p);
+}
+
+void rt_period_tick(struct rt_period *p)
+{
+	uint64_t now = now_ns(), deadline = ts_ns(&p->next), late;
+
+	late = (now > deadline) ? now - deadline : 0;
+	if (late > p->max_late_ns)
+		p->max_late_ns = late;
+
+	if (p->cycles) {
+		if (now - p->last_ns < p->min_ns)
+			p->min_ns = now - p->last_ns;
+		if (now - p->last_ns > p->max_ns)
+			p->max_ns = now - p->last_ns;
+	}
+	p->last_ns = now;
+	p->cycles++;
+
+	/* Skip the deadlines already missed */
+	rt_advance(p);
+	while (late >= p->period_ns) {
+		p->overruns++;
+		late -= p->period_ns;
+		rt_advance(p);
+	}
+}
+
+void rt_period_wait(struct rt_period *p)
+{
+	uint64_t start = 0;
+
+	if (stats_enabled)
+		start = now_ns();
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &p->next,
+	  NULL) == EINTR);
+	if (stats_enabled)
+		stats_delay(1, now_ns() - start);
+	rt_period_tick(p);
+}
+
+void rt_period_report(const struct rt_period *p, FILE *out)
+{
+	fprintf(out, "rt: cycles=%llu period_ns=%llu min_period_ns=%llu "
+	  "max_period_ns=%llu max_late_ns=%llu overruns=%llu\n",
+	  (unsigned long long)p->cycles,
+	  (unsigned long long)p->period_ns,
+	  (unsigned long long)(p->cycles > 1 ? p->min_ns : 0),
+	  (unsigned long long)p->max_ns,
+	  (unsigned long long)p->max_late_ns,
+	  (unsigned long long)p->overruns);
+}
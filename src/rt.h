@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __RT_H__
+#define __RT_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Long options shared by the tools with a real-time mode */
+#define RT_OPT_PRIO	0x100
+#define RT_OPT_CPU	0x101
+#define RT_LONG_OPTIONS \
+	{ "rt", required_argument, NULL, RT_OPT_PRIO }, \
+	{ "cpu", required_argument, NULL, RT_OPT_CPU }
+#define RT_USAGE \
+	"  --rt <prio>            Run SCHED_FIFO at prio 1-99, memory locked\n" \
+	"  --cpu <n>              Run only on CPU n\n"
+
+/* Parse a --rt or --cpu argument into *prio or *cpu.  Returns 0, or -1
+ * after printing an error. */
+int rt_parse(int opt, const char *arg, int *prio, int *cpu);
+
+/* Switch to SCHED_FIFO at prio, unless 0, locking all memory and faulting
+ * in stack so the loop never waits on a page fault.  A cpu of -1 leaves
+ * the affinity alone.  Child processes do not inherit SCHED_FIFO.
+ * Returns 0, or -1 after printing an error. */
+int rt_enable(int prio, int cpu);
+
+/* A fixed-period loop on absolute CLOCK_MONOTONIC deadlines, so time spent
+ * in each cycle does not add to the period, with jitter measurement.  A
+ * cycle that wakes a whole period or more late is an overrun, and missed
+ * deadlines are skipped rather than run back to back. */
+struct rt_period {
+	struct timespec next;
+	uint64_t period_ns;
+	uint64_t last_ns;	/* Wakeup of the previous cycle */
+	uint64_t cycles;
+	uint64_t overruns;
+	uint64_t min_ns;	/* Shortest and longest period seen */
+	uint64_t max_ns;
+	uint64_t max_late_ns;	/* Worst wakeup past the deadline */
+};
+
+void rt_period_init(struct rt_period *p, uint64_t period_ns);
+
+/* Sleep until the next deadline */
+void rt_period_wait(struct rt_period *p);
+
+/* For loops woken by something else, such as a timerfd of the same
+ * period started with rt_period_init(): account for a wakeup now. */
+void rt_period_tick(struct rt_period *p);
+
+void rt_period_report(const struct rt_period *p, FILE *out);
+
+#endif //__RT_H__
@@ -0,0 +1,300 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Outputs "splash.out" in the current directory, a 240x320 RGB565 raw
+ * image suitable for TS-7100 LCD splash screen loading.
+ *
+ * A binary PPM (P6) that is already 240x320 is converted directly.  Any
+ * other image is first decoded, scaled and centered by ImageMagick
+ * 'convert', which also writes a "splash.png" mockup.
+ *
+ * Examples:
+ *  splash-convert -rotate 90 foo.jpg
+ *  splash-convert -background white logo.png
+ *  splash-convert -resize 100x100 -background blue logo.bmp
+ *  splash-convert --dither=fs --output=customer.out customer.ppm
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "rgb565.h"
+
+#define SPLASH_W	240
+#define SPLASH_H	320
+#define SPLASH_GEOM	"240x320"
+#define RGB_SZ		(SPLASH_W * SPLASH_H * 3)
+#define OUT_SZ		(SPLASH_W * SPLASH_H * 2)
+
+extern char **environ;
+
+static void usage(char **argv)
+{
+	fprintf(stderr,
+	  "Usage: %s [-background COLOR] [-resize GEOM] [OPTION] ... "
+	  "some-image-file-name\n"
+	  "Tool to manipulate and format images for use with TS LCD splash\n"
+	  "  screens using SPI NOR flash\n"
+	  "\n"
+	  "  COLOR defaults to \"black\" and GEOM defaults to \"%s\"\n"
+	  "  --dither=MODE          none (default), ordered, or fs\n"
+	  "  --output=FILE          Output file, default splash.out, - for "
+	  "stdout\n"
+	  "  --no-png               Do not write the splash.png mockup\n"
+	  "\n"
+	  "  A 240x320 binary PPM is converted directly.  Other images require\n"
+	  "  ImageMagick 'convert' in $PATH, as do any other options, which\n"
+	  "  are passed to it.\n"
+	  "\n",
+	  argv[0], SPLASH_GEOM
+	);
+}
+
+/* Read exactly len bytes, returns 0 on success */
+static int read_full(int fd, uint8_t *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = read(fd, buf, len);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static int write_full(int fd, const uint8_t *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, buf, len);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/* Parse a PPM header one byte at a time so nothing past it is consumed.
+ * Returns 0 if it is a 240x320 P6 with 8 bit samples. */
+static int read_ppm_header(int fd)
+{
+	int field[3] = { 0, 0, 0 };
+	int i, in_comment = 0, digits = 0;
+	char c, magic[2];
+
+	if (read_full(fd, (uint8_t *)magic, 2) || magic[0] != 'P' ||
+	  magic[1] != '6')
+		return -1;
+
+	for (i = 0; i < 3; ) {
+		if (read(fd, &c, 1) != 1)
+			return -1;
+		if (in_comment) {
+			if (c == '\n')
+				in_comment = 0;
+		} else if (c == '#') {
+			in_comment = 1;
+		} else if (c >= '0' && c <= '9') {
+			field[i] = field[i] * 10 + (c - '0');
+			digits++;
+		} else if (digits) {
+			digits = 0;
+			i++;
+		}
+	}
+
+	if (field[0] != SPLASH_W || field[1] != SPLASH_H || field[2] != 255)
+		return -1;
+
+	return 0;
+}
+
+/* Run convert with its output on a pipe, returns the read end */
+static int spawn_convert(char **args, pid_t *pid)
+{
+	posix_spawn_file_actions_t fa;
+	int pipefd[2], ret;
+
+	if (pipe(pipefd))
+		return -1;
+
+	posix_spawn_file_actions_init(&fa);
+	posix_spawn_file_actions_adddup2(&fa, pipefd[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addclose(&fa, pipefd[0]);
+	posix_spawn_file_actions_addclose(&fa, pipefd[1]);
+	ret = posix_spawnp(pid, "convert", &fa, NULL, args, environ);
+	posix_spawn_file_actions_destroy(&fa);
+	close(pipefd[1]);
+
+	if (ret) {
+		close(pipefd[0]);
+		errno = ret;
+		return -1;
+	}
+
+	return pipefd[0];
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t rgb[RGB_SZ], out[OUT_SZ];
+	enum rgb565_dither dither = RGB565_DITHER_NONE;
+	const char *output = "splash.out";
+	const char *background = "black", *resize = SPLASH_GEOM;
+	char **cargs;
+	int i, n = 0, nforward = 0, fd, outfd, opt_png = 1, status;
+	int need_convert = 0;
+	pid_t pid = 0;
+
+	if (argc < 2) {
+		usage(argv);
+		return 1;
+	}
+
+	/* Worst case: every argument forwarded, plus the fixed ones below */
+	cargs = calloc(argc + 20, sizeof(char *));
+	if (!cargs) {
+		perror("calloc");
+		return 1;
+	}
+	cargs[n++] = "convert";
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-background") && i + 1 < argc) {
+			background = argv[++i];
+			need_convert = 1;
+		} else if (!strcmp(argv[i], "-resize") && i + 1 < argc) {
+			resize = argv[++i];
+			need_convert = 1;
+		} else if (!strncmp(argv[i], "--dither=", 9)) {
+			if (!strcmp(argv[i] + 9, "none"))
+				dither = RGB565_DITHER_NONE;
+			else if (!strcmp(argv[i] + 9, "ordered"))
+				dither = RGB565_DITHER_ORDERED;
+			else if (!strcmp(argv[i] + 9, "fs"))
+				dither = RGB565_DITHER_FS;
+			else {
+				usage(argv);
+				return 1;
+			}
+		} else if (!strncmp(argv[i], "--output=", 9)) {
+			output = argv[i] + 9;
+		} else if (!strcmp(argv[i], "--no-png")) {
+			opt_png = 0;
+		} else if (!strcmp(argv[i], "-h") ||
+		  !strcmp(argv[i], "--help")) {
+			usage(argv);
+			return 1;
+		} else {
+			cargs[n++] = argv[i];
+			nforward++;
+		}
+	}
+
+	if (nforward < 1) {
+		usage(argv);
+		return 1;
+	}
+
+	/* The fast path only applies to a lone input file */
+	fd = -1;
+	if (!need_convert && nforward == 1) {
+		if (!strcmp(cargs[1], "-"))
+			fd = dup(STDIN_FILENO);
+		else
+			fd = open(cargs[1], O_RDONLY);
+		if (fd != -1 && read_ppm_header(fd)) {
+			close(fd);
+			fd = -1;
+			if (!strcmp(cargs[1], "-")) {
+				fprintf(stderr, "stdin must be a 240x320 P6 "
+				  "PPM\n");
+				return 1;
+			}
+		}
+	}
+
+	if (fd == -1) {
+		cargs[n++] = "-resize";
+		cargs[n++] = (char *)resize;
+		cargs[n++] = "-background";
+		cargs[n++] = (char *)background;
+		cargs[n++] = "-compose";
+		cargs[n++] = "Over";
+		cargs[n++] = "-gravity";
+		cargs[n++] = "center";
+		cargs[n++] = "-extent";
+		cargs[n++] = SPLASH_GEOM;
+		cargs[n++] = "-depth";
+		cargs[n++] = "8";
+		if (opt_png) {
+			cargs[n++] = "-write";
+			cargs[n++] = "splash.png";
+		}
+		cargs[n++] = "rgb:-";
+		cargs[n] = NULL;
+
+		fd = spawn_convert(cargs, &pid);
+		if (fd == -1) {
+			fprintf(stderr, "%s: imagemagick 'convert' utility is "
+			  "required: %s\n", argv[0], strerror(errno));
+			return 1;
+		}
+	}
+
+	if (read_full(fd, rgb, RGB_SZ)) {
+		fprintf(stderr, "%s: short image data\n", argv[0]);
+		return 1;
+	}
+	close(fd);
+
+	if (pid) {
+		if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) ||
+		  WEXITSTATUS(status)) {
+			fprintf(stderr, "%s: convert failed\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (rgb565_convert_image(out, rgb, SPLASH_W, SPLASH_H, dither)) {
+		perror("rgb565_convert_image");
+		return 1;
+	}
+
+	if (!strcmp(output, "-"))
+		outfd = STDOUT_FILENO;
+	else
+		outfd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (outfd == -1 || write_full(outfd, out, OUT_SZ)) {
+		perror(output);
+		return 1;
+	}
+	if (outfd != STDOUT_FILENO) {
+		close(outfd);
+		if (pid && opt_png)
+			printf("splash.png: standard image file for splash "
+			  "mockup\n");
+		printf("%s: raw binary RGB565 pixels, big-endian byte "
+		  "ordering\n", output);
+	}
+
+	return 0;
+}
@@ -0,0 +1,271 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Write a splash image produced by splash-convert to SPI NOR, touching only
+ * the erase blocks whose contents differ.
+ *
+ * The target region is read once and compared block by block.  A block that
+ * already matches is skipped.  A block that only needs bits cleared is
+ * programmed without an erase, since NOR programming can only turn 1s into
+ * 0s.  Anything else is erased and programmed.  Finally the whole region is
+ * read back once and verified.
+ *
+ * The target can be an MTD character device, or any regular file standing
+ * in for one, in which case erasing is emulated by writing 0xFF.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <mtd/mtd-user.h>
+
+static int is_mtd;
+static uint32_t erasesize = 4096;
+
+static void usage(char **argv)
+{
+	fprintf(stderr,
+	  "Usage: %s [OPTION] ... <splash.out> <mtd device or file>\n"
+	  "Write a splash image, erasing and programming only changed blocks\n"
+	  "\n"
+	  "  -o, --offset <bytes>   Offset of the splash in the partition, "
+	  "default 0\n"
+	  "  -e, --erasesize <sz>   Erase block size for plain files, default "
+	  "4096\n"
+	  "  -n, --dry-run          Only report what would be written\n"
+	  "  -c, --create           Create the target as a plain file if it does\n"
+	  "                         not exist\n"
+	  "  -h, --help             This message\n"
+	  "\n",
+	  argv[0]
+	);
+}
+
+static int pread_full(int fd, uint8_t *buf, size_t len, off_t off)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = pread(fd, buf, len, off);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		len -= ret;
+		off += ret;
+	}
+
+	return 0;
+}
+
+static int pwrite_full(int fd, const uint8_t *buf, size_t len, off_t off)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = pwrite(fd, buf, len, off);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		len -= ret;
+		off += ret;
+	}
+
+	return 0;
+}
+
+static int erase_block(int fd, off_t off)
+{
+	struct erase_info_user ei;
+	uint8_t *ff;
+	int ret;
+
+	if (is_mtd) {
+		ei.start = off;
+		ei.length = erasesize;
+		return ioctl(fd, MEMERASE, &ei);
+	}
+
+	ff = malloc(erasesize);
+	if (!ff)
+		return -1;
+	memset(ff, 0xff, erasesize);
+	ret = pwrite_full(fd, ff, erasesize, off);
+	free(ff);
+
+	return ret;
+}
+
+/* Programming can only clear bits, so want is reachable without an erase
+ * if it has no 1 bit where cur has a 0 */
+static int needs_erase(const uint8_t *cur, const uint8_t *want, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if ((cur[i] & want[i]) != want[i])
+			return 1;
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct mtd_info_user mtd;
+	struct stat st;
+	uint8_t *img, *cur, *want;
+	off_t offset = 0;
+	size_t imglen, span, blk, nblocks;
+	unsigned long changed = 0, erased = 0;
+	int c, imgfd, fd, opt_dry_run = 0, opt_erasesize = 0, opt_create = 0;
+
+	static struct option long_options[] = {
+	  { "offset", required_argument, NULL, 'o' },
+	  { "erasesize", required_argument, NULL, 'e' },
+	  { "dry-run", no_argument, NULL, 'n' },
+	  { "create", no_argument, NULL, 'c' },
+	  { "help", no_argument, NULL, 'h' },
+	  { NULL, no_argument, NULL, 0 }
+	};
+
+	while((c = getopt_long(argc, argv, "o:e:nch", long_options, NULL)) != -1) {
+		switch (c) {
+		  case 'o':
+			offset = strtoull(optarg, NULL, 0);
+			break;
+		  case 'e':
+			opt_erasesize = strtoul(optarg, NULL, 0);
+			break;
+		  case 'n':
+			opt_dry_run = 1;
+			break;
+		  case 'c':
+			opt_create = 1;
+			break;
+		  case 'h':
+		  default:
+			usage(argv);
+			return 1;
+		}
+	}
+
+	if (argc - optind != 2) {
+		usage(argv);
+		return 1;
+	}
+
+	imgfd = open(argv[optind], O_RDONLY);
+	if (imgfd == -1 || fstat(imgfd, &st)) {
+		perror(argv[optind]);
+		return 1;
+	}
+	imglen = st.st_size;
+
+	/* A mistyped device name must not quietly become a new file */
+	fd = open(argv[optind + 1], opt_dry_run ? O_RDONLY :
+	  O_RDWR | (opt_create ? O_CREAT : 0), 0644);
+	if (fd == -1) {
+		perror(argv[optind + 1]);
+		return 1;
+	}
+
+	if (ioctl(fd, MEMGETINFO, &mtd) == 0) {
+		is_mtd = 1;
+		erasesize = mtd.erasesize;
+		if (offset + imglen > mtd.size) {
+			fprintf(stderr, "Image does not fit in the partition\n");
+			return 1;
+		}
+	} else if (opt_erasesize) {
+		erasesize = opt_erasesize;
+	}
+
+	if (erasesize == 0 || offset % erasesize) {
+		fprintf(stderr, "Offset must be a multiple of the %u byte erase "
+		  "block\n", erasesize);
+		return 1;
+	}
+
+	nblocks = (imglen + erasesize - 1) / erasesize;
+	span = nblocks * erasesize;
+	img = malloc(span);
+	cur = malloc(span);
+	if (!img || !cur) {
+		perror("malloc");
+		return 1;
+	}
+
+	if (pread_full(imgfd, img, imglen, 0)) {
+		perror(argv[optind]);
+		return 1;
+	}
+	close(imgfd);
+
+	/* A plain file may be shorter than the region, treat it as erased */
+	memset(cur, 0xff, span);
+	if (is_mtd) {
+		if (pread_full(fd, cur, span, offset)) {
+			perror("read");
+			return 1;
+		}
+	} else {
+		ssize_t ret = pread(fd, cur, span, offset);
+		if (ret == -1) {
+			perror("read");
+			return 1;
+		}
+	}
+
+	/* The tail of the last block is outside the image, keep it as is */
+	memcpy(img + imglen, cur + imglen, span - imglen);
+
+	for (blk = 0; blk < nblocks; blk++) {
+		off_t boff = blk * erasesize;
+		int erase;
+
+		want = img + boff;
+		if (!memcmp(cur + boff, want, erasesize))
+			continue;
+
+		changed++;
+		erase = needs_erase(cur + boff, want, erasesize);
+		if (erase)
+			erased++;
+		if (opt_dry_run)
+			continue;
+
+		if (erase && erase_block(fd, offset + boff)) {
+			fprintf(stderr, "Erase at 0x%llx failed: %s\n",
+			  (unsigned long long)(offset + boff), strerror(errno));
+			return 1;
+		}
+		if (pwrite_full(fd, want, erasesize, offset + boff)) {
+			fprintf(stderr, "Write at 0x%llx failed: %s\n",
+			  (unsigned long long)(offset + boff), strerror(errno));
+			return 1;
+		}
+	}
+
+	printf("blocks=%zu changed=%lu erased=%lu\n", nblocks, changed, erased);
+
+	if (opt_dry_run || !changed)
+		return 0;
+
+	if (pread_full(fd, cur, span, offset) || memcmp(cur, img, span)) {
+		fprintf(stderr, "Verify failed\n");
+		return 1;
+	}
+
+	return 0;
+}
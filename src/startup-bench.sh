@@ -0,0 +1,73 @@
+#!/bin/sh
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS
+#
+# Startup time of each tool as its own executable and through the
+# multicall binary, one JSON object per line.  Every run is "<tool> -h",
+# which exits before touching hardware.
+#
+# Cold runs drop the page cache first and so need root; without it they
+# are reported as null.  Warm runs are the mean of $RUNS back to back.
+#
+#   startup-bench.sh <builddir> <tool>...
+
+RUNS=${RUNS:-200}
+COLD_RUNS=${COLD_RUNS:-5}
+
+dir=$(cd "$1" && pwd) || exit 1
+shift
+
+links=$(mktemp -d) || exit 1
+trap 'rm -rf "$links"' EXIT
+for t in "$@"; do
+	ln -s "$dir/ts7100-utils" "$links/$t"
+done
+
+can_drop=0
+if [ -w /proc/sys/vm/drop_caches ]; then
+	can_drop=1
+fi
+
+now_ns() {
+	date +%s%N
+}
+
+# Mean microseconds per run of $1, dropping caches before each if $2
+time_runs() {
+	total=0
+	i=0
+	while [ $i -lt $3 ]; do
+		if [ "$2" = 1 ]; then
+			sync
+			echo 3 > /proc/sys/vm/drop_caches
+		fi
+		start=$(now_ns)
+		"$1" -h > /dev/null 2>&1
+		end=$(now_ns)
+		total=$((total + end - start))
+		i=$((i + 1))
+	done
+	echo $((total / $3 / 1000))
+}
+
+for t in "$@"; do
+	for build in separate multicall; do
+		if [ $build = separate ]; then
+			exe="$dir/$t"
+			size=$(wc -c < "$exe")
+		else
+			exe="$links/$t"
+			size=$(wc -c < "$dir/ts7100-utils")
+		fi
+
+		cold=null
+		if [ $can_drop = 1 ]; then
+			cold=$(time_runs "$exe" 1 $COLD_RUNS)
+		fi
+		warm=$(time_runs "$exe" 0 $RUNS)
+
+		printf '{"tool":"%s","build":"%s","size":%s,"cold_us":%s,' \
+		  "$t" $build $size $cold
+		printf '"warm_us":%s,"runs":%s}\n' $warm $RUNS
+	done
+done
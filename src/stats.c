@@ -0,0 +1,301 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Counters and latency histograms shared by all of the tools.
+ *
+ * Everything is gated on stats_enabled, so when it is off each hook costs
+ * a load and a branch and the clock is never read.  FPGA register accesses
+ * are only counted, not timed, since reading the clock takes far longer
+ * than the access itself.
+ *
+ * Time is split three ways: sleeping in clock_nanosleep(), busy-waiting in
+ * short delays, and I/O.  I/O sections are timed from start to end, less
+ * any delays inside them, so the three never overlap.
+ *
+ * The report is formatted by hand and written with write(2), so it can be
+ * produced from a signal handler.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "stats.h"
+
+#define STATS_BUCKETS	32
+
+struct stats_histogram {
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t max_ns;
+	uint64_t bucket[STATS_BUCKETS];	/* [2^n, 2^(n+1)) ns */
+};
+
+static const char * const counter_names[STATS_NCOUNTERS] = {
+	"fpga_read16",
+	"fpga_write16",
+	"fpga_read32",
+	"fpga_write32",
+	"gpio_read",
+	"gpio_write",
+	"syscalls",
+	"sleeps",
+	"spins",
+	"fpga_locks",
+	"fpga_lock_contended",
+};
+
+static const struct {
+	const char *name;
+	int io;
+} hist_info[STATS_NHISTS] = {
+	{ "pc104_io_8_read", 1 },
+	{ "pc104_io_8_write", 1 },
+	{ "pc104_io_16_read", 1 },
+	{ "pc104_io_16_write", 1 },
+	{ "pc104_io_16_alt_read", 1 },
+	{ "pc104_io_16_alt_write", 1 },
+	{ "pc104_mem_8_read", 1 },
+	{ "pc104_mem_8_write", 1 },
+	{ "pc104_mem_16_read", 1 },
+	{ "pc104_mem_16_write", 1 },
+	{ "pc104_mem_16_alt_read", 1 },
+	{ "pc104_mem_16_alt_write", 1 },
+	{ "lcd_write", 0 },
+	{ "lcd_bus", 1 },
+	{ "lcd_status", 1 },
+	{ "keypad_scan", 1 },
+	{ "delay_sleep", 0 },
+	{ "fpga_lock_wait", 0 },
+};
+
+int stats_enabled;
+uint64_t stats_counters[STATS_NCOUNTERS];
+static struct stats_histogram hists[STATS_NHISTS];
+static uint64_t sleep_ns, spin_ns, io_ns;
+static uint64_t start_ns;
+static const char *tool = "";
+static int out_fd = STDERR_FILENO;
+
+uint64_t stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void hist_add(struct stats_histogram *h, uint64_t ns)
+{
+	int b = 0;
+
+	while (b < STATS_BUCKETS - 1 && (ns >> (b + 1)))
+		b++;
+
+	h->count++;
+	h->sum_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+	h->bucket[b]++;
+}
+
+void stats_begin_slow(struct stats_mark *m)
+{
+	m->waited = sleep_ns + spin_ns;
+	m->start = stats_now();
+}
+
+void stats_end_slow(enum stats_hist h, const struct stats_mark *m)
+{
+	uint64_t elapsed = stats_now() - m->start;
+	uint64_t waited = sleep_ns + spin_ns - m->waited;
+
+	hist_add(&hists[h], elapsed);
+	if (hist_info[h].io && elapsed > waited)
+		io_ns += elapsed - waited;
+}
+
+void stats_delay(int slept, uint64_t ns)
+{
+	if (slept) {
+		stats_counters[STATS_SLEEPS]++;
+		stats_counters[STATS_SYSCALLS]++;
+		sleep_ns += ns;
+		hist_add(&hists[STATS_DELAY_SLEEP], ns);
+	} else {
+		stats_counters[STATS_SPINS]++;
+		spin_ns += ns;
+	}
+}
+
+/* Minimal formatting for the signal-safe report */
+struct outbuf {
+	char buf[512];
+	size_t len;
+};
+
+static void out_flush(struct outbuf *o)
+{
+	size_t off = 0;
+	ssize_t ret;
+
+	while (off < o->len) {
+		ret = write(out_fd, o->buf + off, o->len - off);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		off += ret;
+	}
+	o->len = 0;
+}
+
+static void out_str(struct outbuf *o, const char *s)
+{
+	while (*s) {
+		if (o->len == sizeof(o->buf))
+			out_flush(o);
+		o->buf[o->len++] = *s++;
+	}
+}
+
+static void out_u64(struct outbuf *o, uint64_t v)
+{
+	char digits[21];
+	int i = sizeof(digits) - 1;
+
+	digits[i] = 0;
+	do {
+		digits[--i] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	out_str(o, &digits[i]);
+}
+
+static void out_field(struct outbuf *o, const char *name, uint64_t v)
+{
+	out_str(o, " ");
+	out_str(o, name);
+	out_str(o, "=");
+	out_u64(o, v);
+}
+
+/* One line per group, key=value pairs.  Histogram buckets are named by
+ * their lower bound in ns, and only non-empty ones are printed. */
+void stats_dump(void)
+{
+	struct outbuf o;
+	int i, b;
+
+	if (!stats_enabled)
+		return;
+
+	o.len = 0;
+	out_str(&o, "stats: ");
+	out_str(&o, tool);
+	out_field(&o, "pid", getpid());
+	out_field(&o, "elapsed_ns", stats_now() - start_ns);
+	out_field(&o, "sleep_ns", sleep_ns);
+	out_field(&o, "spin_ns", spin_ns);
+	out_field(&o, "io_ns", io_ns);
+	out_str(&o, "\nstats: counters");
+	for (i = 0; i < STATS_NCOUNTERS; i++)
+		if (stats_counters[i])
+			out_field(&o, counter_names[i], stats_counters[i]);
+	out_str(&o, "\n");
+
+	for (i = 0; i < STATS_NHISTS; i++) {
+		if (!hists[i].count)
+			continue;
+		out_str(&o, "stats: hist ");
+		out_str(&o, hist_info[i].name);
+		out_field(&o, "count", hists[i].count);
+		out_field(&o, "avg_ns", hists[i].sum_ns / hists[i].count);
+		out_field(&o, "max_ns", hists[i].max_ns);
+		for (b = 0; b < STATS_BUCKETS; b++) {
+			if (!hists[i].bucket[b])
+				continue;
+			out_str(&o, " ");
+			out_u64(&o, 1ULL << b);
+			out_str(&o, ":");
+			out_u64(&o, hists[i].bucket[b]);
+		}
+		out_str(&o, "\n");
+	}
+	out_flush(&o);
+}
+
+static void on_usr1(int sig)
+{
+	int saved = errno;
+
+	stats_dump();
+	errno = saved;
+}
+
+/* Report, then die from the signal as if stats were not enabled */
+static void on_fatal(int sig)
+{
+	stats_dump();
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static void on_exit_dump(void)
+{
+	stats_dump();
+}
+
+void stats_init(int *argc, char **argv)
+{
+	struct sigaction act;
+	const char *env = getenv("TS_STATS");
+	const char *slash;
+	int i, j;
+
+	for (i = 1; i < *argc; i++) {
+		if (!strcmp(argv[i], "--"))
+			break;
+		if (!strcmp(argv[i], "--stats")) {
+			stats_enabled = 1;
+			for (j = i; j < *argc; j++)
+				argv[j] = argv[j + 1];
+			(*argc)--;
+			i--;
+		}
+	}
+
+	if (env && *env && strcmp(env, "0")) {
+		stats_enabled = 1;
+		if (env[0] == '/') {
+			out_fd = open(env, O_WRONLY | O_APPEND | O_CREAT |
+			  O_CLOEXEC, 0644);
+			if (out_fd == -1)
+				out_fd = STDERR_FILENO;
+		}
+	}
+
+	if (!stats_enabled)
+		return;
+
+	slash = strrchr(argv[0], '/');
+	tool = slash ? slash + 1 : argv[0];
+	start_ns = stats_now();
+	atexit(on_exit_dump);
+
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = on_usr1;
+	act.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &act, NULL);
+
+	/* Tools that catch these themselves replace this later and exit
+	 * normally, which reports through atexit() */
+	act.sa_handler = on_fatal;
+	act.sa_flags = 0;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+}
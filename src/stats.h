@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+
+/* Plain event counters */
+enum stats_counter {
+	STATS_FPGA_READ16,
+	STATS_FPGA_WRITE16,
+	STATS_FPGA_READ32,
+	STATS_FPGA_WRITE32,
+	STATS_GPIO_READ,
+	STATS_GPIO_WRITE,
+	STATS_SYSCALLS,
+	STATS_SLEEPS,
+	STATS_SPINS,
+	STATS_FPGA_LOCKS,
+	STATS_FPGA_LOCK_CONTENDED,
+	STATS_NCOUNTERS
+};
+
+/* Timed functions, each with a log2 latency histogram.  The pc104 entries
+ * also serve as the access counts for that bus. */
+enum stats_hist {
+	STATS_PC104_IO_8_READ,
+	STATS_PC104_IO_8_WRITE,
+	STATS_PC104_IO_16_READ,
+	STATS_PC104_IO_16_WRITE,
+	STATS_PC104_IO_16_ALT_READ,
+	STATS_PC104_IO_16_ALT_WRITE,
+	STATS_PC104_MEM_8_READ,
+	STATS_PC104_MEM_8_WRITE,
+	STATS_PC104_MEM_16_READ,
+	STATS_PC104_MEM_16_WRITE,
+	STATS_PC104_MEM_16_ALT_READ,
+	STATS_PC104_MEM_16_ALT_WRITE,
+	STATS_LCD_WRITE,
+	STATS_LCD_BUS,
+	STATS_LCD_STATUS,
+	STATS_KEYPAD_SCAN,
+	STATS_DELAY_SLEEP,
+	STATS_FPGA_LOCK_WAIT,
+	STATS_NHISTS
+};
+
+/* Start of a timed section */
+struct stats_mark {
+	uint64_t start;
+	uint64_t waited;
+};
+
+extern int stats_enabled;
+extern uint64_t stats_counters[STATS_NCOUNTERS];
+
+/* Enable collection if --stats is in argv, which is removed so the tool's
+ * own option parsing never sees it, or TS_STATS is set to anything other
+ * than 0.  A TS_STATS value starting with / names a file to append the
+ * report to instead of stderr.
+ *
+ * When enabled the report is printed at exit, on SIGUSR1, and on SIGINT or
+ * SIGTERM unless the tool handles those itself.
+ */
+void stats_init(int *argc, char **argv);
+
+/* Write the report now.  This is async-signal-safe. */
+void stats_dump(void);
+
+uint64_t stats_now(void);
+
+static inline void stats_inc(enum stats_counter c)
+{
+	if (stats_enabled)
+		stats_counters[c]++;
+}
+
+static inline void stats_add(enum stats_counter c, uint64_t n)
+{
+	if (stats_enabled)
+		stats_counters[c] += n;
+}
+
+void stats_begin_slow(struct stats_mark *m);
+void stats_end_slow(enum stats_hist h, const struct stats_mark *m);
+
+/* Time the code between stats_begin() and stats_end().  Time spent in
+ * delays inside the section is not counted as I/O. */
+static inline void stats_begin(struct stats_mark *m)
+{
+	if (stats_enabled)
+		stats_begin_slow(m);
+}
+
+static inline void stats_end(enum stats_hist h, const struct stats_mark *m)
+{
+	if (stats_enabled)
+		stats_end_slow(h, m);
+}
+
+/* Account for a delay of ns, slept or busy-waited */
+void stats_delay(int slept, uint64_t ns);
+
+#endif //__STATS_H__
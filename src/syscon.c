@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Snapshot, compare and restore the FPGA syscon page.
+ *
+ * A snapshot is every 32-bit register of the page that fpga_init() maps,
+ * read once in order, saved with a small header so that a file from one
+ * model is never compared with or restored to another.
+ *
+ * Only the bits regmap.def marks rw are ever written back.  A register
+ * with no rw field is treated as read-only, so restore is safe to run with
+ * an incomplete register map.
+ */
+
+#include <endian.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fpga.h"
+#include "fpga_lock.h"
+#include "regmap.h"
+#include "syscon.h"
+
+int syscon_read(struct syscon_snap *snap, int model, uint32_t base)
+{
+	uint32_t i;
+
+	memcpy(snap->hdr.magic, SYSCON_MAGIC, 4);
+	snap->hdr.version = SYSCON_VERSION;
+	snap->hdr.model = model;
+	snap->hdr.base = base;
+	snap->hdr.nregs = getpagesize() / 4;
+
+	snap->regs = malloc(snap->hdr.nregs * 4);
+	if (snap->regs == NULL)
+		return -1;
+
+	for (i = 0; i < snap->hdr.nregs; i++)
+		snap->regs[i] = fpeek32(i * 4);
+
+	return 0;
+}
+
+int syscon_save(const struct syscon_snap *snap, const char *path)
+{
+	struct syscon_hdr hdr = snap->hdr;
+	uint32_t *le;
+	uint32_t i;
+	FILE *f;
+	int ret = 0;
+
+	le = malloc(snap->hdr.nregs * 4);
+	if (le == NULL)
+		return -1;
+	for (i = 0; i < snap->hdr.nregs; i++)
+		le[i] = htole32(snap->regs[i]);
+	hdr.version = htole16(hdr.version);
+	hdr.model = htole16(hdr.model);
+	hdr.base = htole32(hdr.base);
+	hdr.nregs = htole32(hdr.nregs);
+
+	f = fopen(path, "wb");
+	if (f == NULL) {
+		free(le);
+		return -1;
+	}
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	  fwrite(le, 4, snap->hdr.nregs, f) != snap->hdr.nregs)
+		ret = -1;
+	if (fclose(f))
+		ret = -1;
+	free(le);
+
+	return ret;
+}
+
+int syscon_load(struct syscon_snap *snap, const char *path, int model)
+{
+	struct syscon_hdr *hdr = &snap->hdr;
+	uint32_t i;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	if (fread(hdr, sizeof(*hdr), 1, f) != 1 ||
+	  memcmp(hdr->magic, SYSCON_MAGIC, 4)) {
+		fprintf(stderr, "%s: not a syscon snapshot\n", path);
+		fclose(f);
+		return -1;
+	}
+	hdr->version = le16toh(hdr->version);
+	hdr->model = le16toh(hdr->model);
+	hdr->base = le32toh(hdr->base);
+	hdr->nregs = le32toh(hdr->nregs);
+
+	if (hdr->version != SYSCON_VERSION || hdr->nregs == 0 ||
+	  hdr->nregs > 0x10000) {
+		fprintf(stderr, "%s: unsupported snapshot version %u\n", path,
+		  hdr->version);
+		fclose(f);
+		return -1;
+	}
+	if (hdr->model != model) {
+		fprintf(stderr, "%s: snapshot is from a TS-%X, not a TS-%X\n",
+		  path, hdr->model, model);
+		fclose(f);
+		return -1;
+	}
+
+	snap->regs = malloc(hdr->nregs * 4);
+	if (snap->regs == NULL ||
+	  fread(snap->regs, 4, hdr->nregs, f) != hdr->nregs) {
+		fprintf(stderr, "%s: short snapshot\n", path);
+		free(snap->regs);
+		snap->regs = NULL;
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	for (i = 0; i < hdr->nregs; i++)
+		snap->regs[i] = le32toh(snap->regs[i]);
+
+	return 0;
+}
+
+void syscon_free(struct syscon_snap *snap)
+{
+	free(snap->regs);
+	snap->regs = NULL;
+}
+
+int syscon_diff(const struct syscon_snap *a, const struct syscon_snap *b,
+  FILE *out)
+{
+	uint32_t i;
+	int diffs = 0;
+
+	if (a->hdr.model != b->hdr.model || a->hdr.base != b->hdr.base ||
+	  a->hdr.nregs != b->hdr.nregs) {
+		fprintf(stderr, "Snapshots cover different registers\n");
+		return -1;
+	}
+
+	for (i = 0; i < a->hdr.nregs; i++) {
+		if (a->regs[i] != b->regs[i]) {
+			fprintf(out, "0x%03X: 0x%08X 0x%08X\n", i * 4,
+			  a->regs[i], b->regs[i]);
+			diffs++;
+		}
+	}
+
+	return diffs;
+}
+
+int syscon_restore(const struct syscon_snap *snap, FILE *out)
+{
+	uint32_t i, mask, cur, val;
+	int writes = 0;
+
+	/* Other processes see the restore as a single change */
+	fpga_lock();
+	for (i = 0; i < snap->hdr.nregs; i++) {
+		mask = regmap_write_mask(snap->hdr.model, i * 4);
+		if (!mask)
+			continue;
+
+		cur = fpeek32(i * 4);
+		if (!((cur ^ snap->regs[i]) & mask))
+			continue;
+
+		val = fpga_rmw32(i * 4, mask, snap->regs[i]);
+		fprintf(out, "0x%03X: 0x%08X 0x%08X\n", i * 4, cur, val);
+		writes++;
+	}
+	fpga_unlock();
+
+	return writes;
+}
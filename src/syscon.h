@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __SYSCON_H__
+#define __SYSCON_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SYSCON_MAGIC	"TSSC"
+#define SYSCON_VERSION	1
+
+/* Snapshot file header, followed by nregs 32-bit register values.  All
+ * fields are little-endian. */
+struct syscon_hdr {
+	char magic[4];
+	uint16_t version;
+	uint16_t model;
+	uint32_t base;
+	uint32_t nregs;
+};
+
+struct syscon_snap {
+	struct syscon_hdr hdr;
+	uint32_t *regs;
+};
+
+/* Read the whole syscon page with aligned 32-bit reads.  fpga_init() must
+ * already have been called with base.  Returns 0, or -1 on error. */
+int syscon_read(struct syscon_snap *snap, int model, uint32_t base);
+
+int syscon_save(const struct syscon_snap *snap, const char *path);
+
+/* Load a snapshot, checking it was taken from the same model.  Returns 0,
+ * or -1 with an error printed. */
+int syscon_load(struct syscon_snap *snap, const char *path, int model);
+
+void syscon_free(struct syscon_snap *snap);
+
+/* Print each register that differs.  Returns the number of differences,
+ * or -1 if the snapshots are not comparable. */
+int syscon_diff(const struct syscon_snap *a, const struct syscon_snap *b,
+  FILE *out);
+
+/* Write the writable bits of every register that differs from the live
+ * value, printing each write.  Returns the number of registers written. */
+int syscon_restore(const struct syscon_snap *snap, FILE *out);
+
+#endif //__SYSCON_H__
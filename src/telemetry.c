@@ -0,0 +1,217 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+/* Board telemetry published once for any number of readers.
+ *
+ * A single publisher samples a set of syscon registers and writes each
+ * sample into POSIX shared memory under a sequence lock.  The count is
+ * made odd before a sample is written and even again after, and a reader
+ * that sees it odd, or changed across its copy, copies again.  Readers
+ * never write to the segment, so they need no syscalls once it is mapped
+ * and never slow the publisher or each other down.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "fpga.h"
+#include "stats.h"
+#include "telemetry.h"
+
+const char *telemetry_name(void)
+{
+	const char *name = getenv("TS_TELEMETRY");
+
+	return name ? name : TELEMETRY_NAME;
+}
+
+/* PID of the publisher of an existing object if it is still running,
+ * else 0 */
+static pid_t telemetry_owner(const char *name)
+{
+	struct telemetry_shm *t;
+	struct stat st;
+	pid_t pid = 0;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	stats_add(STATS_SYSCALLS, 1);
+	if (fd == -1)
+		return 0;
+	if (fstat(fd, &st) || st.st_size < sizeof(*t)) {
+		close(fd);
+		return 0;
+	}
+	t = mmap(NULL, sizeof(*t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED)
+		return 0;
+
+	/* EPERM still means the process exists */
+	if (t->pid && (!kill(t->pid, 0) || errno == EPERM))
+		pid = t->pid;
+	munmap(t, sizeof(*t));
+	stats_add(STATS_SYSCALLS, 5);
+
+	return pid;
+}
+
+struct telemetry_shm *telemetry_create(const char *name, int model,
+  const uint32_t *offs, int nregs, int period_ms)
+{
+	struct telemetry_shm *t;
+	pid_t pid;
+	int fd;
+
+	if (nregs < 1 || nregs > TELEMETRY_MAX_REGS) {
+		fprintf(stderr, "Telemetry takes 1-%d registers\n",
+		  TELEMETRY_MAX_REGS);
+		return NULL;
+	}
+
+	pid = telemetry_owner(name);
+	if (pid) {
+		fprintf(stderr, "Telemetry %s: already published by pid %d\n",
+		  name, (int)pid);
+		return NULL;
+	}
+
+	/* A new object, so readers of a stale one never see it change */
+	shm_unlink(name);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd == -1) {
+		fprintf(stderr, "Telemetry %s: %s\n", name, strerror(errno));
+		return NULL;
+	}
+	fchmod(fd, 0644);
+	if (ftruncate(fd, sizeof(*t))) {
+		fprintf(stderr, "Telemetry %s: %s\n", name, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	t = mmap(NULL, sizeof(*t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED) {
+		fprintf(stderr, "Telemetry %s: %s\n", name, strerror(errno));
+		return NULL;
+	}
+	stats_add(STATS_SYSCALLS, 5);
+
+	t->size = sizeof(*t);
+	t->pid = getpid();
+	t->snap.model = model;
+	t->snap.nregs = nregs;
+	t->snap.period_ms = period_ms;
+	memcpy(t->snap.offs, offs, nregs * sizeof(*offs));
+
+	return t;
+}
+
+void telemetry_publish(struct telemetry_shm *t)
+{
+	uint32_t value[TELEMETRY_MAX_REGS];
+	struct timespec ts;
+	uint32_t i;
+
+	/* Bus reads happen outside the write side, keeping it short */
+	for (i = 0; i < t->snap.nregs; i++)
+		value[i] = fpeek32(t->snap.offs[i]);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	__atomic_store_n(&t->seq, t->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(t->snap.value, value, t->snap.nregs * sizeof(value[0]));
+	t->snap.timestamp_ns = (uint64_t)ts.tv_sec * 1000000000ULL +
+	  ts.tv_nsec;
+	t->snap.samples++;
+
+	__atomic_store_n(&t->seq, t->seq + 1, __ATOMIC_RELEASE);
+
+	/* Readers check the magic, so it is only set once there is data */
+	if (t->magic != TELEMETRY_MAGIC)
+		__atomic_store_n(&t->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+}
+
+void telemetry_destroy(struct telemetry_shm *t, const char *name)
+{
+	munmap(t, sizeof(*t));
+	shm_unlink(name);
+}
+
+const struct telemetry_shm *telemetry_open(const char *name)
+{
+	struct telemetry_shm *t;
+	struct stat st;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd == -1) {
+		fprintf(stderr, "Telemetry %s: %s, is a publisher running?\n",
+		  name, strerror(errno));
+		return NULL;
+	}
+	if (fstat(fd, &st) || st.st_size < sizeof(*t)) {
+		fprintf(stderr, "Telemetry %s: not a telemetry segment\n",
+		  name);
+		close(fd);
+		return NULL;
+	}
+
+	t = mmap(NULL, sizeof(*t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED) {
+		fprintf(stderr, "Telemetry %s: %s\n", name, strerror(errno));
+		return NULL;
+	}
+	stats_add(STATS_SYSCALLS, 4);
+
+	return t;
+}
+
+int telemetry_read(const struct telemetry_shm *t, struct telemetry_snap *snap)
+{
+	const struct timespec pause = { 0, 100000 };
+	uint32_t seq;
+	int tries;
+
+	if (__atomic_load_n(&t->magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC ||
+	  t->size != sizeof(*t)) {
+		errno = ENODATA;
+		return -1;
+	}
+
+	/* Spin briefly, then sleep so that a publisher preempted mid sample
+	 * on the same CPU gets to finish.  One that died there leaves the
+	 * count odd for good, so give up after about 100ms. */
+	for (tries = 0; ; tries++) {
+		seq = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+		if (!(seq & 1)) {
+			memcpy(snap, &t->snap, sizeof(*snap));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (seq == __atomic_load_n(&t->seq, __ATOMIC_RELAXED))
+				break;
+		}
+		if (tries == TELEMETRY_READ_SPINS + TELEMETRY_READ_SLEEPS) {
+			errno = EAGAIN;
+			return -1;
+		}
+		if (tries >= TELEMETRY_READ_SPINS)
+			nanosleep(&pause, NULL);
+	}
+
+	if (snap->nregs > TELEMETRY_MAX_REGS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* Copyright (c) 2019-2022 Technologic Systems, Inc. dba embeddedTS */
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <stdint.h>
+
+/* POSIX shared memory object, TS_TELEMETRY overrides */
+#define TELEMETRY_NAME		"/ts-telemetry"
+#define TELEMETRY_MAGIC		0x544c4d31	/* "TLM1" */
+#define TELEMETRY_MAX_REGS	64
+/* telemetry_read() retries without a syscall, then with a 100us sleep */
+#define TELEMETRY_READ_SPINS	1000
+#define TELEMETRY_READ_SLEEPS	1000
+
+/* One sample of every published register */
+struct telemetry_snap {
+	uint32_t model;
+	uint32_t nregs;
+	uint32_t period_ms;
+	uint32_t pad;
+	uint64_t timestamp_ns;		/* CLOCK_MONOTONIC of the sample */
+	uint64_t samples;		/* Published since the start */
+	uint32_t offs[TELEMETRY_MAX_REGS];
+	uint32_t value[TELEMETRY_MAX_REGS];
+};
+
+/* The seqlock count is odd while the publisher is writing */
+struct telemetry_shm {
+	uint32_t magic;
+	uint32_t size;
+	uint32_t seq;
+	uint32_t pid;			/* Of the publisher */
+	struct telemetry_snap snap;
+};
+
+/* Returns the object name from TS_TELEMETRY, or the default */
+const char *telemetry_name(void);
+
+/* Create the object, replacing one left behind by a publisher that is no
+ * longer running, and set the registers each sample reads.  Returns NULL
+ * after printing an error, including when another publisher is live. */
+struct telemetry_shm *telemetry_create(const char *name, int model,
+  const uint32_t *offs, int nregs, int period_ms);
+
+/* Read every register with fpeek32() and publish them as one sample */
+void telemetry_publish(struct telemetry_shm *t);
+
+void telemetry_destroy(struct telemetry_shm *t, const char *name);
+
+/* Map the object read-only.  Returns NULL after printing an error. */
+const struct telemetry_shm *telemetry_open(const char *name);
+
+/* Copy a consistent sample, retrying while one is being published.  No
+ * syscalls are made unless the publisher stalls mid sample.  Returns 0,
+ * or -1 with errno ENODATA if nothing was published yet, or EAGAIN if no
+ * consistent copy was had in about 100ms, as when the publisher died
+ * mid sample. */
+int telemetry_read(const struct telemetry_shm *t, struct telemetry_snap *snap);
+
+#endif //__TELEMETRY_H__
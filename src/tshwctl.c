@@ -5,6 +5,7 @@
 #include <errno.h>
 #include <error.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <getopt.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -13,16 +14,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "dio.h"
 #include "eval_cmdline.h"
 #include "fpga.h"
+#include "fpga_irq.h"
+#include "fpga_lock.h"
 #include "helpers.h"
+#include "regmap.h"
+#include "rt.h"
+#include "stats.h"
+#include "syscon.h"
+#include "telemetry.h"
 
-const char copyright[] = "Copyright (c) embeddedTS - " __DATE__ " - "
+static const char copyright[] = "Copyright (c) embeddedTS - " __DATE__ " - "
   GITCOMMIT;
 
-int model = 0;
+static int model = 0;
 
-void do_info(void)
+static void do_info(void)
 {
 	fpga_init(0x50004000);
 	eval_cmd_init();
@@ -84,6 +93,282 @@ void do_info(void)
 	}
 }
 
+/* Snapshot, diff and restore of the syscon page.  The live registers are
+ * read at most once.  Returns the exit status. */
+static int do_syscon(const char *snapshot, const char *diff, const char *compare,
+  const char *restore)
+{
+	struct syscon_snap live = { .regs = NULL }, base, other;
+	int ret = 0, n;
+
+	fpga_init(0x50004000);
+
+	if (snapshot || (diff && !compare)) {
+		if (syscon_read(&live, model, 0x50004000)) {
+			perror("syscon_read");
+			return 1;
+		}
+	}
+
+	if (snapshot && syscon_save(&live, snapshot)) {
+		perror(snapshot);
+		return 1;
+	}
+
+	if (diff) {
+		if (syscon_load(&base, diff, model))
+			return 1;
+		if (compare) {
+			if (syscon_load(&other, compare, model))
+				return 1;
+			n = syscon_diff(&base, &other, stdout);
+			syscon_free(&other);
+		} else {
+			n = syscon_diff(&base, &live, stdout);
+		}
+		syscon_free(&base);
+		if (n < 0)
+			return 1;
+		if (n > 0)
+			ret = 1;
+	}
+
+	if (restore) {
+		if (syscon_load(&base, restore, model))
+			return 1;
+		syscon_restore(&base, stdout);
+		syscon_free(&base);
+	}
+
+	syscon_free(&live);
+
+	return ret;
+}
+
+/* Block on the UIO interrupt until (reg & mask) == value.  Returns the exit
+ * status, 2 on timeout. */
+static int do_wait(const char *uio, uint32_t offs, char *cond, int timeout_ms)
+{
+	struct fpga_irq_cond c;
+	struct fpga_irq irq;
+	char *end;
+
+	if (uio == NULL) {
+		fprintf(stderr, "--wait needs the interrupt device, --uio\n");
+		return 1;
+	}
+	if (offs & 0x3) {
+		error(EFAULT, EFAULT, "Address offset must be 32 bit "
+		  "aligned for 32 bit FPGA accesses");
+	}
+
+	c.offs = offs;
+	c.mask = strtoul(cond, &end, 0);
+	c.value = c.mask;
+	if (*end == ':')
+		c.value = strtoul(end + 1, &end, 0);
+	if (*end != '\0' || (c.value & ~c.mask)) {
+		fprintf(stderr, "Invalid condition \"%s\", expected "
+		  "<mask>[:<value>]\n", cond);
+		return 1;
+	}
+
+	fpga_init(0x50004000);
+	if (fpga_irq_open(&irq, uio)) {
+		perror(uio);
+		return 1;
+	}
+
+	if (fpga_irq_wait(&irq, &c, 1, timeout_ms) < 0) {
+		if (errno != ETIMEDOUT) {
+			perror(uio);
+			return 1;
+		}
+		fpga_irq_close(&irq);
+		return 2;
+	}
+	printf("0x%08X\n", fpeek32(offs));
+	fpga_irq_close(&irq);
+
+	return 0;
+}
+
+/* Resolve a register offset, or a name from regmap.def.  A field gives
+ * its mask and shift, a register or offset covers all 32 bits.  Returns 0,
+ * or -1 after printing an error. */
+static int reg_resolve(const char *arg, uint32_t *offs, uint32_t *mask,
+  int *shift)
+{
+	const struct regmap_entry *e;
+	char *end;
+
+	*offs = strtoul(arg, &end, 0);
+	*mask = 0xffffffff;
+	*shift = 0;
+	if (*arg && *end == '\0')
+		return 0;
+
+	e = regmap_lookup(model, arg);
+	if (e == NULL) {
+		fprintf(stderr, "Unknown register \"%s\", see --regmap\n", arg);
+		return -1;
+	}
+	*offs = e->offs;
+	*mask = regmap_mask(e);
+	*shift = e->lsb;
+
+	return 0;
+}
+
+/* Each line of stdin is a register or field, to print its value, or
+ * register=value to write it.  Returns the exit status. */
+static int do_batch(FILE *in)
+{
+	char line[256], *eq, *end;
+	uint32_t offs, mask, val;
+	int shift, lineno = 0;
+
+	fpga_init(0x50004000);
+
+	while (fgets(line, sizeof(line), in)) {
+		lineno++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+
+		eq = strchr(line, '=');
+		if (eq)
+			*eq = '\0';
+		if (reg_resolve(line, &offs, &mask, &shift))
+			return 1;
+		if (offs & 0x3) {
+			fprintf(stderr, "line %d: offset must be 32 bit "
+			  "aligned\n", lineno);
+			return 1;
+		}
+		if (offs >= getpagesize()) {
+			fprintf(stderr, "line %d: offset out of range\n",
+			  lineno);
+			return 1;
+		}
+
+		if (!eq) {
+			printf("%s=0x%X\n", line, (fpeek32(offs) & mask) >> shift);
+			continue;
+		}
+
+		val = strtoul(eq + 1, &end, 0);
+		if (eq[1] == '\0' || *end || ((val << shift) & ~mask) ||
+		  (shift && val >> (32 - shift))) {
+			fprintf(stderr, "line %d: bad value for %s\n", lineno,
+			  line);
+			return 1;
+		}
+		fpga_rmw32(offs, mask, val << shift);
+	}
+
+	return 0;
+}
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig)
+{
+	quit = 1;
+}
+
+/* Sample the registers in list, or those --info reads for "info", at hz
+ * until SIGINT or SIGTERM.  Returns the exit status. */
+static int do_publish(char *list, int hz)
+{
+	uint32_t offs[TELEMETRY_MAX_REGS];
+	struct telemetry_shm *t;
+	struct rt_period period;
+	struct sigaction act;
+	const char *name = telemetry_name();
+	char *tok, *save, *end;
+	int n = 0;
+
+	if (!strcmp(list, "info")) {
+		offs[n++] = 0x0;
+		if (model == 0x7250) {
+			offs[n++] = 0x4;
+			offs[n++] = 0x8;
+		}
+	} else {
+		for (tok = strtok_r(list, ",", &save); tok;
+		  tok = strtok_r(NULL, ",", &save)) {
+			if (n == TELEMETRY_MAX_REGS) {
+				fprintf(stderr, "At most %d registers\n",
+				  TELEMETRY_MAX_REGS);
+				return 1;
+			}
+			offs[n] = strtoul(tok, &end, 0);
+			if (*end || (offs[n] & 0x3) ||
+			  offs[n] >= getpagesize()) {
+				fprintf(stderr, "Invalid register \"%s\"\n",
+				  tok);
+				return 1;
+			}
+			n++;
+		}
+	}
+
+	fpga_init(0x50004000);
+	t = telemetry_create(name, model, offs, n, 1000 / hz);
+	if (t == NULL)
+		return 1;
+
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = on_signal;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+
+	rt_period_init(&period, 1000000000ULL / hz);
+	while (!quit) {
+		telemetry_publish(t);
+		rt_period_wait(&period);
+	}
+
+	telemetry_destroy(t, name);
+
+	return 0;
+}
+
+/* Print the latest sample without touching the FPGA */
+static int do_telemetry(void)
+{
+	const struct telemetry_shm *t;
+	struct telemetry_snap snap;
+	struct timespec now;
+	uint64_t now_ns;
+	uint32_t i;
+
+	t = telemetry_open(telemetry_name());
+	if (t == NULL)
+		return 1;
+	if (telemetry_read(t, &snap)) {
+		if (errno == EAGAIN)
+			fprintf(stderr, "Telemetry publisher is stuck or dead\n");
+		else
+			fprintf(stderr, "No telemetry published yet\n");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+	printf("MODEL=%X\n", snap.model);
+	printf("SAMPLES=%llu\n", (unsigned long long)snap.samples);
+	printf("PERIOD_MS=%u\n", snap.period_ms);
+	printf("AGE_MS=%llu\n",
+	  (unsigned long long)(now_ns - snap.timestamp_ns) / 1000000);
+	for (i = 0; i < snap.nregs; i++)
+		printf("REG_0x%03X=0x%08X\n", snap.offs[i], snap.value[i]);
+
+	return 0;
+}
+
 static void usage(char **argv) {
 	fprintf(stderr,
 	  "%s\n\n"
@@ -91,11 +376,42 @@ static void usage(char **argv) {
 	  "embeddedTS Hardware access\n"
 	  "\n"
 	  "  -i, --info             Get info about the SBC\n"
-	  "  -a, --address <addr>   Set syscon addr offset for FPGA peek/poke\n"
+	  "  -a, --address <addr>   Set syscon addr offset for FPGA peek/poke,\n"
+	  "                         or a register or REGISTER.FIELD name.  A\n"
+	  "                         field is read and written shifted down\n"
+	  "  -M, --regmap           List register and field names\n"
+	  "  -b, --batch            Read a register or field name or offset per\n"
+	  "                         line from stdin and print NAME=value, or\n"
+	  "                         write NAME=value lines\n"
 	  "  -r, --peek16           16bit FPGA syscon read, must pass -a too\n"
 	  "  -w, --poke16 <value>   16bit FPGA syscon write, must pass -a too\n"
 	  "  -l, --peek32           32bit FPGA syscon read, must pass -a too\n"
 	  "  -L, --poke32 <value>   32bit FPGA syscon write, must pass -a too\n"
+	  "  -m, --mask <mask>      Only change these bits with --poke16/32,\n"
+	  "                         keeping the rest of the register\n"
+	  "  -s, --dio-set <list>   Set DIO lines, e.g. LCD_RS=1,chip5:1=0\n"
+	  "  -g, --dio-get <list>   Read DIO lines, e.g. KEYPAD_COL0,chip5:7\n"
+	  "  -D, --dio-list         List DIO line names known for this board\n"
+	  "  -S, --snapshot <file>  Save every syscon register to a file\n"
+	  "  -d, --diff <file>      Compare a snapshot with the live registers,\n"
+	  "                         printing offset, snapshot and live values\n"
+	  "                         of each difference.  Exits 1 if any differ\n"
+	  "  -c, --compare <file>   With --diff, compare with this snapshot\n"
+	  "                         instead of the live registers\n"
+	  "  -R, --restore <file>   Write back writable registers that differ\n"
+	  "  -W, --wait <mask>[:<value>]\n"
+	  "                         Sleep until the 32bit syscon register at -a,\n"
+	  "                         masked, equals value (default mask), waking\n"
+	  "                         on each interrupt.  Prints the register\n"
+	  "  -u, --uio <dev>        UIO device of the FPGA interrupt for --wait\n"
+	  "  -t, --timeout <ms>     Give up --wait after ms, exiting 2\n"
+	  "  -P, --publish <regs>   Sample comma separated syscon registers, or\n"
+	  "                         \"info\" for those --info reads, into shared\n"
+	  "                         memory until interrupted\n"
+	  "  -f, --rate <hz>        Samples per second for --publish, default 10\n"
+	  "  -T, --telemetry        Print the latest published sample\n"
+	  "  -k, --lock-stats       Print FPGA lock use by all processes\n"
+	  "  --stats                Report bus access counts and timing at exit\n"
 	  "  -h, --help             This message\n"
 	  "\n",
 	  copyright, argv[0]
@@ -107,19 +423,50 @@ int main(int argc, char **argv)
 	int c;
 	int opt_info = 0;
 	int opt_peek16 = 0, opt_poke16 = 0, opt_peek32 = 0, opt_poke32 = 0;
-	uint32_t opt_address = 0x1, opt_pokeval = 0;
+	uint32_t opt_address = 0x1, opt_pokeval = 0, opt_mask = 0xffffffff;
+	uint32_t opt_field = 0xffffffff;
+	int opt_shift = 0, opt_regmap = 0, opt_batch = 0;
+	int opt_lock_stats = 0, opt_telemetry = 0, opt_rate = 10;
+	char *opt_publish = NULL;
+	struct fpga_lock_stats lock_stats;
+	char *opt_dio_set = NULL, *opt_dio_get = NULL;
+	int opt_dio_list = 0;
+	char *opt_snapshot = NULL, *opt_diff = NULL, *opt_compare = NULL;
+	char *opt_restore = NULL;
+	char *opt_wait = NULL, *opt_uio = NULL;
+	int opt_timeout = -1;
+	int ret = 0;
 
 	static struct option long_options[] = {
 	  { "info", no_argument, NULL, 'i' },
 	  { "help", no_argument, NULL, 'h' },
 	  { "address", required_argument, NULL, 'a' },
+	  { "regmap", no_argument, NULL, 'M' },
+	  { "batch", no_argument, NULL, 'b' },
 	  { "peek16", no_argument, NULL, 'r' },
 	  { "poke16", required_argument, NULL, 'w' },
 	  { "peek32", no_argument, NULL, 'l' },
 	  { "poke32", required_argument, NULL, 'L' },
+	  { "dio-set", required_argument, NULL, 's' },
+	  { "dio-get", required_argument, NULL, 'g' },
+	  { "dio-list", no_argument, NULL, 'D' },
+	  { "snapshot", required_argument, NULL, 'S' },
+	  { "diff", required_argument, NULL, 'd' },
+	  { "compare", required_argument, NULL, 'c' },
+	  { "restore", required_argument, NULL, 'R' },
+	  { "mask", required_argument, NULL, 'm' },
+	  { "lock-stats", no_argument, NULL, 'k' },
+	  { "publish", required_argument, NULL, 'P' },
+	  { "rate", required_argument, NULL, 'f' },
+	  { "telemetry", no_argument, NULL, 'T' },
+	  { "wait", required_argument, NULL, 'W' },
+	  { "uio", required_argument, NULL, 'u' },
+	  { "timeout", required_argument, NULL, 't' },
 	  { NULL, no_argument, NULL, 0 }
 	};
 
+	stats_init(&argc, argv);
+
 	if(argc == 1) {
 		usage(argv);
 		return 1;
@@ -136,14 +483,22 @@ int main(int argc, char **argv)
 	}
 
 	while((c = getopt_long(argc, argv, 
-	  "iha:rw:lL:",
+	  "iha:Mbrw:lL:m:kP:f:Ts:g:DS:d:c:R:W:u:t:",
 	  long_options, NULL)) != -1) {
 		switch (c) {
 		  case 'i': /* FPGA info */
 			opt_info = 1;
 			break;
 		  case 'a': /* FPGA Address */
-			opt_address = strtoul(optarg, NULL, 0);
+			if (reg_resolve(optarg, &opt_address, &opt_field,
+			  &opt_shift))
+				return 1;
+			break;
+		  case 'M':
+			opt_regmap = 1;
+			break;
+		  case 'b':
+			opt_batch = 1;
 			break;
 		  case 'r': /* FPGA Peek16 */
 			opt_peek16 = 1;
@@ -159,6 +514,55 @@ int main(int argc, char **argv)
 			opt_poke32 = 1;
 			opt_pokeval = strtoul(optarg, NULL, 0);
 			break;
+		  case 'm':
+			opt_mask = strtoul(optarg, NULL, 0);
+			break;
+		  case 'k':
+			opt_lock_stats = 1;
+			break;
+		  case 'P':
+			opt_publish = optarg;
+			break;
+		  case 'f':
+			opt_rate = atoi(optarg);
+			if (opt_rate < 1 || opt_rate > 1000) {
+				fprintf(stderr, "Rate must be 1-1000 Hz\n");
+				return 1;
+			}
+			break;
+		  case 'T':
+			opt_telemetry = 1;
+			break;
+		  case 's': /* Bulk DIO set */
+			opt_dio_set = optarg;
+			break;
+		  case 'g': /* Bulk DIO get */
+			opt_dio_get = optarg;
+			break;
+		  case 'D':
+			opt_dio_list = 1;
+			break;
+		  case 'S':
+			opt_snapshot = optarg;
+			break;
+		  case 'd':
+			opt_diff = optarg;
+			break;
+		  case 'c':
+			opt_compare = optarg;
+			break;
+		  case 'R':
+			opt_restore = optarg;
+			break;
+		  case 'W':
+			opt_wait = optarg;
+			break;
+		  case 'u':
+			opt_uio = optarg;
+			break;
+		  case 't':
+			opt_timeout = strtoul(optarg, NULL, 0);
+			break;
 		  case 'h':
 		  default:
 			usage(argv);
@@ -170,14 +574,29 @@ int main(int argc, char **argv)
 		do_info();
 	}
 
+	if (opt_regmap) {
+		regmap_list(model, stdout);
+	}
+
 	if (opt_peek16 || opt_poke16) {
+		if (opt_field != 0xffffffff) {
+			fprintf(stderr, "Fields are read and written with "
+			  "--peek32 and --poke32\n");
+			return 1;
+		}
 		if (opt_address & 0x1) {
 			error(EFAULT, EFAULT, "Address offset must be 16 bit "
 			  "aligned for 16 bit FPGA accesses");
 		}
+		/* The default of all ones covers all 16 bits */
+		if (opt_poke16 && opt_mask != 0xffffffff && opt_mask > 0xffff) {
+			fprintf(stderr, "Mask 0x%X has bits above 15, which "
+			  "--poke16 cannot change\n", opt_mask);
+			return 1;
+		}
 
 		fpga_init(0x50004000);
-		if (opt_poke16) fpoke16(opt_address, opt_pokeval & 0xFFFF);
+		if (opt_poke16) fpga_rmw16(opt_address, opt_mask, opt_pokeval);
 		if (opt_peek16) printf("0x%04X\n", fpeek16(opt_address));
 	}
 
@@ -187,10 +606,67 @@ int main(int argc, char **argv)
 			  "aligned for 32 bit FPGA accesses");
 		}
 
+		if (opt_poke32 && (((opt_pokeval << opt_shift) & ~opt_field) ||
+		  (opt_shift && opt_pokeval >> (32 - opt_shift)))) {
+			fprintf(stderr, "Value does not fit the field\n");
+			return 1;
+		}
+
 		fpga_init(0x50004000);
-		if (opt_poke32) fpoke32(opt_address, opt_pokeval);
-		if (opt_peek32) printf("0x%08X\n", fpeek32(opt_address));
+		if (opt_poke32) fpga_rmw32(opt_address, opt_mask & opt_field,
+		  opt_pokeval << opt_shift);
+		if (opt_peek32 && opt_field != 0xffffffff)
+			printf("0x%X\n", (fpeek32(opt_address) & opt_field) >>
+			  opt_shift);
+		else if (opt_peek32)
+			printf("0x%08X\n", fpeek32(opt_address));
 	}
 
-	return 0;
+	if (opt_lock_stats) {
+		if (fpga_lock_stats(&lock_stats))
+			return 1;
+		printf("LOCK_ACQUIRED=%llu\n",
+		  (unsigned long long)lock_stats.acquired);
+		printf("LOCK_CONTENDED=%llu\n",
+		  (unsigned long long)lock_stats.contended);
+		printf("LOCK_OWNER_DIED=%llu\n",
+		  (unsigned long long)lock_stats.owner_died);
+	}
+
+	if (opt_dio_list) {
+		dio_list(model, stdout);
+	}
+
+	/* Set before get, so lines can be read back in the same call */
+	if (opt_dio_set && dio_set(model, opt_dio_set)) {
+		return 1;
+	}
+
+	if (opt_dio_get && dio_get(model, opt_dio_get, stdout)) {
+		return 1;
+	}
+
+	if (opt_snapshot || opt_diff || opt_restore) {
+		ret = do_syscon(opt_snapshot, opt_diff, opt_compare,
+		  opt_restore);
+	}
+
+	if (opt_wait && ret == 0) {
+		ret = do_wait(opt_uio, opt_address, opt_wait, opt_timeout);
+	}
+
+	if (opt_batch && ret == 0) {
+		ret = do_batch(stdin);
+	}
+
+	if (opt_telemetry && ret == 0) {
+		ret = do_telemetry();
+	}
+
+	/* Runs until interrupted, so comes last */
+	if (opt_publish && ret == 0) {
+		ret = do_publish(opt_publish, opt_rate);
+	}
+
+	return ret;
 }